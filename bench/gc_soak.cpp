@@ -0,0 +1,95 @@
+#include "../core/collector.h"
+#include "../core/main/parser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+
+// every call leaves a cycle behind: the unfinished generator and map() iterator keep the call's scope alive, and that
+// scope's variables hold them. Without the cycle collector each call leaks its scope
+static const char *CHURN = "def numbers(n) as\n"
+                           "    for i in 1..n do\n"
+                           "        yield i\n"
+                           "    stop\n"
+                           "stop\n"
+                           "def double(x) as\n"
+                           "    return x * 2\n"
+                           "stop\n"
+                           "def churn(i) as\n"
+                           "    source := numbers(10)\n"
+                           "    doubled := map(double, source)\n"
+                           "    first := take(doubled, 2)\n"
+                           "    xs := [i, i + 1, i + 2]\n"
+                           "    d := {\"i\": i, \"xs\": xs}\n"
+                           "    return d[\"i\"]\n"
+                           "stop\n";
+
+
+// the resident set size right now, unlike the peak that getrusage() reports
+static long residentKilobytes() {
+    std::ifstream statm("/proc/self/statm");
+    long size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+
+int main(int argc, char **argv) {
+    long iterations = 3000000;
+    long rounds = 30;
+    // how far above the first round's resident size any later round may go, as a share of it
+    double tolerance = 0.25;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = std::max(1L, std::atol(argv[i] + 13));
+        } else if (std::strncmp(argv[i], "--rounds=", 9) == 0) {
+            rounds = std::max(2L, std::atol(argv[i] + 9));
+        } else if (std::strncmp(argv[i], "--tolerance=", 12) == 0) {
+            tolerance = std::atof(argv[i] + 12);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--iterations=N] [--rounds=N] [--tolerance=share]" << std::endl;
+            return 2;
+        }
+    }
+    long perRound = std::max(1L, iterations / rounds);
+
+    Lexer lexer("");
+    Parser parser(lexer);
+    lexer.reset(std::string(CHURN) + "for i in 1.." + std::to_string(perRound) + " do\n    churn(i)\nstop\n");
+    parser.advanceToken();
+    auto statements = parser.parse();
+    auto loop = std::move(statements.back());
+    statements.pop_back();
+    auto globalScope = std::make_shared<Scope>();
+    for (const auto &statement: statements) {
+        statement->evaluate(globalScope);
+    }
+
+    // the first round warms up the pools and the allocator, so later rounds are compared with it
+    long baseline = 0, highest = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long round = 1; round <= rounds; ++round) {
+        loop->evaluate(globalScope);
+        long resident = residentKilobytes();
+        if (round == 1) {
+            baseline = resident;
+        }
+        highest = std::max(highest, resident);
+        Collector::Stats stats = Collector::instance().getStats();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "round " << round << ": " << round * perRound << " iterations, " << seconds << "s, rss "
+                  << resident << "KB, live scopes " << stats.liveScopes << ", longest pause "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(stats.longestPause).count() << "us"
+                  << std::endl;
+    }
+
+    long limit = baseline + static_cast<long>(baseline * tolerance);
+    bool flat = highest <= limit;
+    std::cout << "{\"iterations\": " << rounds * perRound << ", \"baseline_rss_kb\": " << baseline
+              << ", \"highest_rss_kb\": " << highest << ", \"limit_rss_kb\": " << limit
+              << ", \"flat\": " << (flat ? "true" : "false") << "}" << std::endl;
+    return flat ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+#include "../core/main/parser.h"
+#include "../util/quota.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+
+// every allocation the interpreter makes goes through these, so a run can count them
+static std::atomic<size_t> allocations{0};
+
+
+// kept out of line: once they are inlined into a caller, GCC sees memory from new reach free() and warns about a
+// mismatched deallocation and a use after free
+__attribute__((noinline)) void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+
+__attribute__((noinline)) void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+
+__attribute__((noinline)) void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+
+struct Run {
+    double milliseconds;
+    size_t allocations;
+    long peakKilobytes;
+    size_t peakQuota;
+    bool succeeded;
+};
+
+// what a child process reports back through its pipe
+struct Report {
+    double milliseconds;
+    size_t allocations;
+    size_t peakQuota;
+    bool succeeded;
+};
+
+
+// parses and runs a script the way the interpreter does in script mode, with its output thrown away
+static Report runScript(const std::string &source) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    close(null);
+
+    size_t before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    bool succeeded = true;
+    try {
+        Lexer lexer("");
+        Parser parser(lexer);
+        lexer.reset(source + "\n");
+        parser.advanceToken();
+        auto globalScope = std::make_shared<Scope>();
+        for (const auto &statement: parser.parse()) {
+            statement->evaluate(globalScope);
+        }
+    } catch (...) {
+        succeeded = false;
+    }
+    std::cout.flush();
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return {milliseconds, allocations.load() - before, peakMemory(), succeeded};
+}
+
+
+// every run gets a fresh process, so that peak memory and the interpreter's global state don't carry over.
+// threads, unless it is 0, is how many threads the parallel builtins get in it
+static Run runOnce(const std::string &source, size_t threads) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("pipe() failed");
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        throw std::runtime_error("fork() failed");
+    }
+    if (child == 0) {
+        close(fds[0]);
+        if (threads) {
+            setenv("INTERP_THREADS", std::to_string(threads).c_str(), 1);
+        }
+        Report report = runScript(source);
+        ssize_t written = write(fds[1], &report, sizeof(report));
+        _exit(written == sizeof(report) ? 0 : 1);
+    }
+    close(fds[1]);
+    Report report{};
+    bool received = read(fds[0], &report, sizeof(report)) == sizeof(report);
+    close(fds[0]);
+    int status;
+    rusage usage{};
+    wait4(child, &status, 0, &usage);
+    return {report.milliseconds, report.allocations, usage.ru_maxrss, report.peakQuota,
+            received && report.succeeded && WIFEXITED(status) && WEXITSTATUS(status) == 0};
+}
+
+
+// the value below which the given share of the sorted values lie, by nearest rank
+static double percentile(const std::vector<double> &sorted, double share) {
+    size_t rank = static_cast<size_t>(share * sorted.size() + 0.999999);
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+
+int main(int argc, char **argv) {
+    int runs = 5;
+    std::string output;
+    std::vector<std::string> scripts;
+    // charging the runs' allocations to a quota this large measures what the accounting costs
+    size_t memoryLimit = 0;
+    // every script is run once per thread count, to see how the parallel builtins scale
+    std::vector<size_t> threadCounts;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = std::max(1, std::atoi(argv[i] + 7));
+        } else if (std::strncmp(argv[i], "--out=", 6) == 0) {
+            output = argv[i] + 6;
+        } else if (std::strncmp(argv[i], "--memory-limit=", 15) == 0) {
+            memoryLimit = std::strtoul(argv[i] + 15, nullptr, 10);
+            setMemoryLimit(memoryLimit);
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            threadCounts = {1, 2, 4, std::max<size_t>(1, std::thread::hardware_concurrency())};
+        } else if (std::strncmp(argv[i], "--threads=", 10) == 0) {
+            std::stringstream counts(argv[i] + 10);
+            for (std::string count; std::getline(counts, count, ',');) {
+                threadCounts.push_back(std::max<size_t>(1, std::strtoul(count.c_str(), nullptr, 10)));
+            }
+        } else if (argv[i][0] != '-') {
+            scripts.emplace_back(argv[i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--runs=N] [--out=file] [--memory-limit=bytes] [--threads[=1,2,...]] [script...]" << std::endl;
+            return 2;
+        }
+    }
+    if (scripts.empty()) {
+        for (const auto &entry: std::filesystem::directory_iterator(BENCH_DIR)) {
+            if (entry.path().extension() == ".txt") {
+                scripts.push_back(entry.path().string());
+            }
+        }
+        std::sort(scripts.begin(), scripts.end());
+    }
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+    if (threadCounts.empty()) {
+        threadCounts.push_back(0);
+    }
+
+    std::stringstream json;
+    json << std::fixed;
+    json.precision(3);
+    std::cerr << std::fixed;
+    std::cerr.precision(1);
+    json << "{\n  \"runs\": " << runs << ",\n  \"memory_limit\": " << memoryLimit << ",\n  \"benchmarks\": [";
+    bool failed = false;
+    bool first = true;
+    for (size_t i = 0; i < scripts.size(); ++i) {
+        std::ifstream file(scripts[i]);
+        if (!file) {
+            std::cerr << "Cannot open " << scripts[i] << std::endl;
+            return 1;
+        }
+        std::stringstream source;
+        source << file.rdbuf();
+
+        // the median with the fewest threads, which the others are compared to
+        double baseline = 0;
+        for (size_t threads: threadCounts) {
+            std::vector<double> times;
+            long peak = 0;
+            size_t allocated = 0, quota = 0;
+            bool succeeded = true;
+            for (int run = 0; run < runs; ++run) {
+                Run result = runOnce(source.str(), threads);
+                times.push_back(result.milliseconds);
+                peak = std::max(peak, result.peakKilobytes);
+                allocated = result.allocations;
+                quota = std::max(quota, result.peakQuota);
+                succeeded = succeeded && result.succeeded;
+            }
+            std::sort(times.begin(), times.end());
+            failed = failed || !succeeded;
+            double median = percentile(times, 0.5);
+            if (!baseline) {
+                baseline = median;
+            }
+
+            std::string name = std::filesystem::path(scripts[i]).stem().string();
+            std::cerr << name;
+            if (threads) {
+                std::cerr << " (" << threads << " threads)";
+            }
+            std::cerr << ": median " << median << "ms, p95 " << percentile(times, 0.95) << "ms, peak " << peak
+                      << "KB, " << allocated << " allocations";
+            if (threads) {
+                std::cerr << ", speedup " << baseline / median << 'x';
+            }
+            std::cerr << (succeeded ? "" : " (FAILED)") << std::endl;
+            json << (first ? "\n" : ",\n") << "    {\"name\": \"" << name << "\", ";
+            if (threads) {
+                json << "\"threads\": " << threads << ", \"speedup\": " << baseline / median << ", ";
+            }
+            json << "\"median_ms\": " << median << ", \"p95_ms\": " << percentile(times, 0.95)
+                 << ", \"min_ms\": " << times.front() << ", \"peak_rss_kb\": " << peak
+                 << ", \"allocations\": " << allocated;
+            if (memoryLimit) {
+                json << ", \"peak_quota_bytes\": " << quota;
+            }
+            json << ", \"succeeded\": " << (succeeded ? "true" : "false") << '}';
+            first = false;
+        }
+    }
+    json << "\n  ]\n}\n";
+
+    if (output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream(output) << json.str();
+    }
+    return failed ? 1 : 0;
+}
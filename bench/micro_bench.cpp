@@ -0,0 +1,729 @@
+#include "../core/main/parser.h"
+#include "../util/functions.h"
+#include "../util/simd.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <unordered_map>
+
+
+// every allocation goes through these, so a benchmark can report how many one operation makes
+static std::atomic<size_t> allocations{0};
+
+
+// kept out of line: once they are inlined into a caller, GCC sees memory from new reach free() and warns about a
+// mismatched deallocation and a use after free
+__attribute__((noinline)) void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+
+__attribute__((noinline)) void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+
+__attribute__((noinline)) void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+
+// keeps the compiler from dropping a result nobody reads
+template<typename T>
+static void keep(const T &value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+
+struct Result {
+    std::string name;
+    // per operation, over the batches
+    double medianNs, minNs, madNs;
+    double allocationsPerOp;
+    // what one operation processes, like tokens, when it is more than one item
+    double itemsPerOp;
+    std::string unit;
+};
+
+static std::vector<Result> results;
+static std::string filter;
+
+static constexpr int BATCHES = 15;
+static constexpr auto BATCH_TIME = std::chrono::milliseconds(20);
+
+
+// runs operation(iterations) in batches that take about BATCH_TIME each, after one batch to warm up, and records the
+// median, fastest and median absolute deviation of the time per operation, and the allocations per operation
+static void measure(const std::string &name, const std::function<void(size_t)> &operation, double itemsPerOp = 1,
+                    const std::string &unit = "") {
+    if (name.find(filter) == std::string::npos) {
+        return;
+    }
+    using Clock = std::chrono::steady_clock;
+    size_t iterations = 1;
+    while (true) {
+        auto start = Clock::now();
+        operation(iterations);
+        if (Clock::now() - start >= BATCH_TIME || iterations >= (size_t(1) << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> perOp;
+    size_t allocatedBefore = allocations.load();
+    for (int batch = 0; batch < BATCHES; ++batch) {
+        auto start = Clock::now();
+        operation(iterations);
+        perOp.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations);
+    }
+    double allocationsPerOp = double(allocations.load() - allocatedBefore) / (double(iterations) * BATCHES);
+    std::sort(perOp.begin(), perOp.end());
+    double median = perOp[BATCHES / 2];
+    std::vector<double> deviations;
+    for (double ns: perOp) {
+        deviations.push_back(std::abs(ns - median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    results.push_back({name, median, perOp.front(), deviations[BATCHES / 2], allocationsPerOp, itemsPerOp, unit});
+
+    std::cerr << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << median << " ns/op  +-" << std::setw(8) << deviations[BATCHES / 2] << " ns"
+              << std::setw(10) << std::setprecision(2) << allocationsPerOp << " allocs/op";
+    if (!unit.empty()) {
+        std::cerr << std::setw(14) << std::setprecision(0) << itemsPerOp / median * 1e9 << ' ' << unit << "/s";
+    }
+    std::cerr << std::endl;
+}
+
+
+// a mix of the statements real scripts are made of
+static std::string generateSource(size_t functions) {
+    std::string source;
+    for (size_t i = 0; i < functions; ++i) {
+        std::string n = std::to_string(i);
+        source += "def f" + n + "(a, b) as\n"
+                  "    total := 0\n"
+                  "    for i in 1..a do\n"
+                  "        if i % 2 == 0 then\n"
+                  "            total = total + i * b\n"
+                  "        else\n"
+                  "            total = total - 1.5 as int\n"
+                  "        stop\n"
+                  "    stop\n"
+                  "    xs := [1, 2.5, \"three\", true]\n"
+                  "    d := {\"key\": xs, 2: total}\n"
+                  "    return d[2] + xs.len()\n"
+                  "stop\n"
+                  "result" + n + " := f" + n + "(10, " + n + ")\n";
+    }
+    return source;
+}
+
+
+static size_t countTokens(Lexer &lexer, const std::string &source) {
+    lexer.reset(source);
+    size_t tokens = 0;
+    while (lexer.getNextToken().getType() != TokenType::END) {
+        ++tokens;
+    }
+    return tokens;
+}
+
+
+static void benchLexer() {
+    std::string source = generateSource(200);
+    Lexer lexer("");
+    double tokens = countTokens(lexer, source);
+    measure("lexer/getNextToken", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            keep(countTokens(lexer, source));
+        }
+    }, tokens, "tokens");
+}
+
+
+static void benchParser() {
+    std::string source = generateSource(200);
+    Lexer lexer("");
+    Parser parser(lexer);
+    // the tree has no generic way to walk its nodes, so tokens consumed stand in for nodes built
+    double tokens = countTokens(lexer, source);
+    measure("parser/parse", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            lexer.reset(source);
+            parser.advanceToken();
+            keep(parser.parse());
+        }
+    }, tokens, "tokens");
+}
+
+
+static void benchScope() {
+    for (size_t depth: {1, 8, 64, 512}) {
+        auto root = std::make_shared<Scope>();
+        root->setVariable("target", Value(ValueBase(42L)));
+        for (int i = 0; i < 8; ++i) {
+            root->setVariable("other" + std::to_string(i), Value(ValueBase(static_cast<long>(i))));
+        }
+        std::vector<std::shared_ptr<Scope>> chain{root};
+        for (size_t i = 1; i < depth; ++i) {
+            chain.push_back(chain.back()->createChildScope());
+            chain.back()->setVariable("local", Value(ValueBase(static_cast<long>(i))));
+        }
+        const auto &leaf = chain.back();
+        measure("scope/getVariable depth " + std::to_string(depth), [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                keep(leaf->getVariable("target"));
+            }
+        });
+    }
+}
+
+
+// what createChildScope() allocated before scopes came from the pool: a make_shared block, and heap nodes and buckets
+// for the variables
+struct HeapScope {
+    std::shared_ptr<Scope> parent;
+    std::unordered_map<std::string, Value> variables;
+    std::unordered_map<std::string, std::shared_ptr<FunctionDeclarationNode>> functions;
+
+    explicit HeapScope(std::shared_ptr<Scope> parent) : parent(std::move(parent)) {}
+};
+
+
+static void benchScopeCreation() {
+    auto root = std::make_shared<Scope>();
+    Value local(ValueBase(1L));
+    measure("scope/child + local, pooled", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            auto child = root->createChildScope();
+            child->setVariable("local", local);
+            keep(child);
+        }
+    });
+    measure("scope/child + local, heap", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            auto child = std::make_shared<HeapScope>(root);
+            child->variables.emplace("local", local);
+            keep(child);
+        }
+    });
+}
+
+
+static void benchValues() {
+    const long size = 100000;
+    Storage<long> ints(size);
+    for (long i = 0; i < size; ++i) {
+        ints[i] = i;
+    }
+    ValueList boxed;
+    for (long i = 0; i < size; ++i) {
+        boxed.push_back(i % 2 ? Value(ValueBase(i)) : Value(ValueBase(std::to_string(i))));
+    }
+    ValueDict dict;
+    for (long i = 0; i < size / 10; ++i) {
+        dict[ValueBase(i)] = Value(ValueBase(std::to_string(i)));
+    }
+
+    struct Case {
+        std::string name;
+        Value value;
+    };
+    for (Case &c: std::vector<Case>{{"int list 100k", Value(ValueList(ints))}, {"mixed list 100k", Value(boxed)},
+                                    {"dict 10k", Value(dict)}, {"str 100k", Value(ValueBase(std::string(size, 'x')))}}) {
+        measure("value/copy " + c.name, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                Value copy = c.value;
+                keep(copy);
+            }
+        });
+        // what every copy cost before payloads were shared
+        measure("value/deep copy " + c.name, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                Value copy = c.value.isList() ? Value(c.value.asList())
+                           : c.value.isDict() ? Value(c.value.asDict()) : Value(c.value.asBase());
+                keep(copy);
+            }
+        });
+        measure("value/move " + c.name, [&](size_t iterations) {
+            Value value = c.value;
+            for (size_t i = 0; i < iterations; ++i) {
+                Value moved = std::move(value);
+                value = std::move(moved);
+            }
+            keep(value);
+        });
+        // the copy on write a shared container makes the first time one of its copies changes
+        measure("value/copy+write " + c.name, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                Value copy = c.value;
+                if (copy.isList()) {
+                    copy.updateListElement(0, Value(ValueBase(1L)));
+                } else if (copy.isDict()) {
+                    copy.setDictElement(ValueBase(0L), Value(ValueBase(1L)));
+                } else {
+                    std::get<std::string>(copy.asBase())[0] = 'y';
+                }
+                keep(copy);
+            }
+        });
+    }
+}
+
+
+// a list that starts with a string keeps its elements boxed, like every list did before ints, floats and bools were
+// stored unboxed. It stays boxed once the string is erased, as long as it isn't emptied
+static ValueList boxedList() {
+    ValueList list;
+    list.push_back(Value(ValueBase(std::string("box"))));
+    return list;
+}
+
+
+static void benchLists() {
+    const long size = 100000;
+    for (bool unboxed: {true, false}) {
+        std::string storage = unboxed ? "unboxed" : "boxed";
+        measure("list/append 100k ints, " + storage, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                ValueList list = unboxed ? ValueList() : boxedList();
+                for (long n = 0; n < size; ++n) {
+                    list.push_back(Value(ValueBase(n)));
+                }
+                keep(list);
+            }
+        }, size, "elements");
+
+        ValueList list = unboxed ? ValueList() : boxedList();
+        for (long n = 0; n < size; ++n) {
+            list.push_back(Value(ValueBase(n)));
+        }
+        if (!unboxed) {
+            list.erase(0);
+        }
+        // the copy a write to a shared list makes
+        measure("list/detach 100k ints, " + storage, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                ValueList copy(list);
+                keep(copy);
+            }
+        }, size, "elements");
+        // the loop the numeric builtins run
+        measure("list/scan 100k ints, " + storage, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                long total = 0;
+                if (unboxed) {
+                    for (long n: *list.ints()) {
+                        total += n;
+                    }
+                } else {
+                    for (const Value &n: *list.boxed()) {
+                        total += std::get<long>(n.asBase());
+                    }
+                }
+                keep(total);
+            }
+        }, size, "elements");
+    }
+}
+
+
+// statements that can be evaluated over and over
+static std::vector<std::unique_ptr<ASTNode>> parseProgram(const std::string &source) {
+    Lexer lexer("");
+    Parser parser(lexer);
+    lexer.reset(source);
+    parser.advanceToken();
+    return parser.parse();
+}
+
+
+static void benchVectors() {
+    const size_t size = 100000;
+    Storage<long> ints(size);
+    Storage<double> floats(size), out(size);
+    for (size_t i = 0; i < size; ++i) {
+        ints[i] = static_cast<long>(i % 1000) - 500;
+        floats[i] = 0.5 * static_cast<double>(i % 1000);
+    }
+    for (bool simd: {true, false}) {
+        useSimd(simd);
+        std::string kernel = simd ? "avx2" : "scalar";
+        measure("vector/sum 100k ints, " + kernel, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                long total;
+                keep(sumInts(ints.data(), size, total));
+                keep(total);
+            }
+        }, size, "elements");
+        measure("vector/sum 100k floats, " + kernel, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                keep(sumFloats(floats.data(), size));
+            }
+        }, size, "elements");
+        measure("vector/max 100k ints, " + kernel, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                keep(maxInts(ints.data(), size));
+            }
+        }, size, "elements");
+        measure("vector/dot 100k floats, " + kernel, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                keep(dotFloats(floats.data(), floats.data(), size));
+            }
+        }, size, "elements");
+        measure("vector/add 100k floats, " + kernel, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                addFloats(floats.data(), floats.data(), out.data(), size);
+                keep(out);
+            }
+        }, size, "elements");
+    }
+    useSimd(true);
+
+    // the builtin against the loop a script needed before it
+    auto scope = std::make_shared<Scope>();
+    scope->setVariable("xs", Value(ValueList(ints)));
+    auto builtin = parseProgram("total := sum(xs)\n");
+    auto loop = parseProgram("total := 0\nfor i in 0..99999 do\n    total = total + xs[i]\nstop\n");
+    for (const auto &[name, program]: {std::pair{"builtin", &builtin}, std::pair{"loop", &loop}}) {
+        measure(std::string("vector/sum() 100k ints, ") + name, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                auto child = scope->createChildScope();
+                for (const auto &statement: *program) {
+                    statement->evaluate(child);
+                }
+                keep(child);
+            }
+        }, size, "elements");
+    }
+}
+
+
+// building a 100KB string from 10-byte pieces. Going through a temporary is what every 's = s + piece' did before it
+// appended in place: a copy of the whole string per piece
+static void benchStringBuilding() {
+    auto scope = std::make_shared<Scope>();
+    auto inPlace = parseProgram("s := \"\"\nfor i in 1..10000 do\n    s = s + \"0123456789\"\nstop\n");
+    auto copying = parseProgram("s := \"\"\nfor i in 1..10000 do\n    t := s + \"0123456789\"\n    s = t\nstop\n");
+    for (const auto &[name, program]: {std::pair{"in place", &inPlace}, std::pair{"copying", &copying}}) {
+        measure(std::string("string/build 100KB, ") + name, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                auto child = scope->createChildScope();
+                for (const auto &statement: *program) {
+                    statement->evaluate(child);
+                }
+                keep(child);
+            }
+        }, 10000, "pieces");
+    }
+}
+
+
+// ltrim() as it was before it scanned the string once: a character lookup from the start of the string, and a new
+// string, for every character it looked at
+static void trimPerCharacter(Value &caller, const std::string &trimChars) {
+    std::string base = std::get<std::string>(std::as_const(caller).asBase());
+    size_t start = 0, i = 0;
+    while (start < base.size()) {
+        std::string currChar = getStrChar(base, i);
+        if (trimChars.find(currChar) == std::string::npos) {
+            break;
+        }
+        start += currChar.size();
+        ++i;
+    }
+    caller = Value(ValueBase(base.substr(start)));
+}
+
+
+static void benchStringMethods() {
+    Value padded(ValueBase(std::string(10000, ' ') + "x"));
+    std::vector<Value> spaces{Value(ValueBase(std::string(" ")))};
+    measure("string/ltrim 10k spaces, one pass", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            Value copy = padded;
+            sltrim(copy, spaces);
+            keep(copy);
+        }
+    });
+    measure("string/ltrim 10k spaces, per char", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            Value copy = padded;
+            trimPerCharacter(copy, " ");
+            keep(copy);
+        }
+    });
+
+    // a needle whose first and last bytes are common in the haystack, which is the hard case for the filter
+    std::string haystack;
+    for (size_t i = 0; haystack.size() < 1000000; ++i) {
+        haystack += "field" + std::to_string(i) + ",";
+    }
+    std::string needle = "field999999,";
+    for (bool simd: {true, false}) {
+        useSimd(simd);
+        measure(std::string("string/find in 1MB, ") + (simd ? "avx2" : "scalar"), [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                keep(findBytes(haystack.data(), haystack.size(), needle.data(), needle.size()));
+            }
+        }, static_cast<double>(haystack.size()), "bytes");
+    }
+    useSimd(true);
+}
+
+
+// reading characters spread over a 40k-character string, through the cached index against walking from the start as
+// every read did before
+static void benchUtf8Indexing() {
+    const size_t length = 40000;
+    std::string ascii, mixed;
+    for (size_t i = 0; i < length; ++i) {
+        ascii += static_cast<char>('a' + i % 26);
+        mixed += i % 3 ? "a" : "\xC3\xA9";
+    }
+    for (const auto &[name, text]: {std::pair{"ascii", &ascii}, std::pair{"non-ascii", &mixed}}) {
+        Utf8Index index;
+        measure(std::string("utf8/index 40k ") + name + ", cached", [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                keep(index.charAt(*text, i * 7919 % length));
+            }
+        });
+        measure(std::string("utf8/index 40k ") + name + ", scan", [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                keep(getStrChar(*text, i * 7919 % length));
+            }
+        });
+    }
+}
+
+
+// the dictionary before it kept its entries in insertion order in an open-addressing table
+using NodeDict = std::unordered_map<ValueBase, Value>;
+
+static const Value *findEntry(const ValueDict &dict, const ValueBase &key) { return dict.find(key); }
+
+static const Value *findEntry(const NodeDict &dict, const ValueBase &key) {
+    auto it = dict.find(key);
+    return it == dict.end() ? nullptr : &it->second;
+}
+
+static const Value &entryValue(const ValueDict::Entry &entry) { return entry.value; }
+
+static const Value &entryValue(const NodeDict::value_type &entry) { return entry.second; }
+
+
+template<typename Dict>
+static void benchDict(const std::string &name) {
+    const long size = 100000;
+    std::vector<ValueBase> keys;
+    for (long i = 0; i < size; ++i) {
+        keys.emplace_back(i % 2 ? ValueBase(i * 7919) : ValueBase("key" + std::to_string(i)));
+    }
+    Value one(ValueBase(1L));
+    measure("dict/insert 100k, " + name, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            Dict dict;
+            for (const ValueBase &key: keys) {
+                dict[key] = one;
+            }
+            keep(dict);
+        }
+    }, size, "entries");
+
+    Dict dict;
+    for (const ValueBase &key: keys) {
+        dict[key] = one;
+    }
+    measure("dict/lookup 100k, " + name, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            size_t found = 0;
+            for (const ValueBase &key: keys) {
+                found += findEntry(std::as_const(dict), key) != nullptr;
+            }
+            keep(found);
+        }
+    }, size, "entries");
+    measure("dict/iterate 100k, " + name, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            size_t ints = 0;
+            for (const auto &entry: std::as_const(dict)) {
+                ints += entryValue(entry).isBase();
+            }
+            keep(ints);
+        }
+    }, size, "entries");
+    measure("dict/copy 100k, " + name, [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            Dict copy(dict);
+            keep(copy);
+        }
+    }, size, "entries");
+}
+
+
+// a filter, map and reduce over 10k numbers as one lazy chain, against the append loops that built a list for every
+// step before range(), map(), filter() and reduce() existed
+static void benchPipelines() {
+    auto scope = std::make_shared<Scope>();
+    for (const auto &statement: parseProgram("def even(x) as\n    return x % 2 == 0\nstop\n"
+                                             "def sq(x) as\n    return x * x\nstop\n"
+                                             "def plus(a, b) as\n    return a + b\nstop\n")) {
+        statement->evaluate(scope);
+    }
+    auto lazy = parseProgram("total := reduce(plus, map(sq, filter(even, range(0, 9999))))\n");
+    auto eager = parseProgram("evens := []\n"
+                              "for i in 0..9999 do\n"
+                              "    if even(i) then\n"
+                              "        evens.append(i)\n"
+                              "    stop\n"
+                              "stop\n"
+                              "squares := []\n"
+                              "for i in 0..evens.len() - 1 do\n"
+                              "    squares.append(sq(evens[i]))\n"
+                              "stop\n"
+                              "total := 0\n"
+                              "for i in 0..squares.len() - 1 do\n"
+                              "    total = plus(total, squares[i])\n"
+                              "stop\n");
+    for (const auto &[name, program]: {std::pair{"lazy", &lazy}, std::pair{"eager", &eager}}) {
+        measure(std::string("pipeline/filter+map+reduce 10k, ") + name, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                auto child = scope->createChildScope();
+                for (const auto &statement: *program) {
+                    statement->evaluate(child);
+                }
+                keep(child);
+            }
+        }, 10000, "elements");
+    }
+}
+
+
+static void benchBinaryOps() {
+    auto scope = std::make_shared<Scope>();
+    struct Case {
+        std::string name;
+        TokenType op;
+        std::function<std::unique_ptr<ASTNode>()> operand;
+    };
+    std::vector<Case> cases = {
+            {"int + int", TokenType::PLUS, [] { return std::make_unique<IntNode>(12345); }},
+            {"int * int", TokenType::ASTER, [] { return std::make_unique<IntNode>(12345); }},
+            {"int < int", TokenType::LT, [] { return std::make_unique<IntNode>(12345); }},
+            {"float * float", TokenType::ASTER, [] { return std::make_unique<FloatNode>(1.5); }},
+            {"float / float", TokenType::SLASH, [] { return std::make_unique<FloatNode>(1.5); }},
+            {"str + str", TokenType::PLUS, [] { return std::make_unique<StringNode>("hello"); }},
+            {"str == str", TokenType::EQUAL, [] { return std::make_unique<StringNode>("hello"); }},
+            {"bool & bool", TokenType::AND, [] { return std::make_unique<BoolNode>(true); }},
+    };
+    for (const Case &c: cases) {
+        BinaryOpNode node(c.op, c.operand(), c.operand());
+        measure("binary/" + c.name, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                keep(node.evaluate(scope));
+            }
+        });
+    }
+}
+
+
+static void benchCalls() {
+    auto scope = std::make_shared<Scope>();
+    Lexer lexer("");
+    Parser parser(lexer);
+    lexer.reset("def identity(x) as\n    return x\nstop\ndef empty() as\n    0\nstop\n");
+    parser.advanceToken();
+    for (const auto &statement: parser.parse()) {
+        statement->evaluate(scope);
+    }
+
+    std::vector<std::unique_ptr<ASTNode>> arguments;
+    arguments.push_back(std::make_unique<IntNode>(1));
+    FunctionCallNode identity("identity", std::move(arguments));
+    FunctionCallNode empty("empty", {});
+    std::vector<std::unique_ptr<ASTNode>> typeArguments;
+    typeArguments.push_back(std::make_unique<IntNode>(1));
+    FunctionCallNode builtin("type", std::move(typeArguments));
+
+    measure("call/user function, no return", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            keep(empty.evaluate(scope));
+        }
+    });
+    measure("call/user function, return", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            keep(identity.evaluate(scope));
+        }
+    });
+    measure("call/builtin", [&](size_t iterations) {
+        for (size_t i = 0; i < iterations; ++i) {
+            keep(builtin.evaluate(scope));
+        }
+    });
+}
+
+
+int main(int argc, char **argv) {
+    std::string output;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--filter=", 9) == 0) {
+            filter = argv[i] + 9;
+        } else if (std::strncmp(argv[i], "--out=", 6) == 0) {
+            output = argv[i] + 6;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--filter=substring] [--out=file]" << std::endl;
+            return 2;
+        }
+    }
+
+    benchLexer();
+    benchParser();
+    benchScope();
+    benchScopeCreation();
+    benchValues();
+    benchLists();
+    benchDict<ValueDict>("open addressing");
+    benchDict<NodeDict>("node map");
+    benchVectors();
+    benchStringBuilding();
+    benchStringMethods();
+    benchUtf8Indexing();
+    benchPipelines();
+    benchBinaryOps();
+    benchCalls();
+
+    std::stringstream json;
+    json << std::fixed << std::setprecision(3) << "{\n  \"batches\": " << BATCHES << ",\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+        json << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.name << "\", \"median_ns\": " << result.medianNs
+             << ", \"min_ns\": " << result.minNs << ", \"mad_ns\": " << result.madNs
+             << ", \"allocations_per_op\": " << result.allocationsPerOp;
+        if (!result.unit.empty()) {
+            json << ", \"" << result.unit << "_per_second\": " << result.itemsPerOp / result.medianNs * 1e9;
+        }
+        json << '}';
+    }
+    json << "\n  ]\n}\n";
+    if (output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream(output) << json.str();
+    }
+    return 0;
+}
@@ -0,0 +1,316 @@
+#include "../util/threadpool.h"
+#include "collector.h"
+#include "heap.h"
+#include "scope.h"
+#include <algorithm>
+
+
+static size_t scopeBytes(const Scope::Map<Value> &variables) {
+    return sizeof(Scope) + variables.bucket_count() * sizeof(void *) +
+           variables.size() * (sizeof(std::pair<const std::string, Value>) + 2 * sizeof(void *));
+}
+
+
+void Tracer::addNode(Kind kind, const void *object, long references, size_t bytes) {
+    index.emplace(object, nodes.size());
+    nodes.push_back(Node{kind, object, references, bytes});
+}
+
+
+void Tracer::edge(Kind kind, const void *object, long useCount, size_t bytes) {
+    size_t target;
+    auto it = index.find(object);
+    if (it != index.end()) {
+        target = it->second;
+    } else if (kind == Kind::SCOPE) {
+        return;
+    } else {
+        target = nodes.size();
+        addNode(kind, object, useCount, bytes);
+    }
+    --nodes[target].references;
+    edges.push_back(target);
+    ++nodes[current].edgeCount;
+}
+
+
+void Tracer::expand(size_t node) {
+    current = node;
+    nodes[node].firstEdge = edges.size();
+    const void *object = nodes[node].object;
+    switch (nodes[node].kind) {
+        case Kind::SCOPE: {
+            auto scope = static_cast<const Scope *>(object);
+            visit(scope->parent);
+            for (const auto &[name, value]: scope->variables) {
+                visit(value);
+            }
+            break;
+        }
+        case Kind::LIST:
+            // unboxed elements can't refer to anything
+            if (auto boxed = static_cast<const ValueList *>(object)->boxed()) {
+                for (const Value &element: *boxed) {
+                    visit(element);
+                }
+            }
+            break;
+        case Kind::DICT:
+            for (const auto &entry: *static_cast<const ValueDict *>(object)) {
+                visit(entry.value);
+            }
+            break;
+        case Kind::ITERATOR:
+            static_cast<const ValueIterator *>(object)->traverse(*this);
+            break;
+        case Kind::CLOSURE:
+            for (const auto &[name, value]: static_cast<const Closure *>(object)->captures) {
+                visit(value);
+            }
+            break;
+    }
+}
+
+
+void Tracer::visit(const std::shared_ptr<Scope> &scope) {
+    if (scope) {
+        edge(Kind::SCOPE, scope.get(), 0, 0);
+    }
+}
+
+
+void Tracer::visit(const std::shared_ptr<ValueList> &list) {
+    edge(Kind::LIST, list.get(), list.use_count(), payloadBytes(*list));
+}
+
+
+void Tracer::visit(const std::shared_ptr<ValueDict> &dict) {
+    edge(Kind::DICT, dict.get(), dict.use_count(), payloadBytes(*dict));
+}
+
+
+void Tracer::visit(const std::shared_ptr<ValueIterator> &iterator) {
+    edge(Kind::ITERATOR, iterator.get(), iterator.use_count(), 0);
+}
+
+
+void Tracer::visit(const std::shared_ptr<const Closure> &closure) {
+    edge(Kind::CLOSURE, closure.get(), closure.use_count(), sizeof(Closure));
+}
+
+
+Collector &Collector::instance() {
+    static Collector collector;
+    return collector;
+}
+
+
+void Collector::link(Scope *&list, Scope *scope) {
+    scope->previousTracked = nullptr;
+    scope->nextTracked = list;
+    if (list) {
+        list->previousTracked = scope;
+    }
+    list = scope;
+}
+
+
+void Collector::unlink(Scope *&list, Scope *scope) {
+    if (scope->previousTracked) {
+        scope->previousTracked->nextTracked = scope->nextTracked;
+    } else {
+        list = scope->nextTracked;
+    }
+    if (scope->nextTracked) {
+        scope->nextTracked->previousTracked = scope->previousTracked;
+    }
+}
+
+
+// the calling thread's young generation; nullptr while the thread is exiting, once it is gone
+static thread_local bool generationDestroyed = false;
+
+static YoungGeneration *threadGeneration() {
+    static thread_local YoungGeneration generation;
+    return generationDestroyed ? nullptr : &generation;
+}
+
+
+YoungGeneration::YoungGeneration() {
+    Collector &collector = Collector::instance();
+    std::lock_guard<std::mutex> lock(collector.mutex);
+    collector.generations.push_back(this);
+}
+
+
+YoungGeneration::~YoungGeneration() {
+    Collector &collector = Collector::instance();
+    std::lock_guard<std::mutex> lock(collector.mutex);
+    std::lock_guard<std::mutex> own(mutex);
+    while (Scope *scope = scopes) {
+        Collector::unlink(scopes, scope);
+        scope->generation = nullptr;
+        Collector::link(collector.old, scope);
+        ++collector.oldCount;
+    }
+    collector.generations.erase(std::find(collector.generations.begin(), collector.generations.end(), this));
+    generationDestroyed = true;
+}
+
+
+void Collector::track(Scope *scope) {
+    if (YoungGeneration *generation = threadGeneration()) {
+        std::lock_guard<std::mutex> lock(generation->mutex);
+        scope->generation = generation;
+        link(generation->scopes, scope);
+        generation->count.store(generation->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    link(old, scope);
+    ++oldCount;
+}
+
+
+void Collector::untrack(Scope *scope) {
+    if (YoungGeneration *generation = scope->generation) {
+        std::lock_guard<std::mutex> lock(generation->mutex);
+        // a collection may have made it old in the meantime
+        if (scope->generation == generation) {
+            unlink(generation->scopes, scope);
+            generation->count.store(generation->count.load(std::memory_order_relaxed) - 1,
+                                    std::memory_order_relaxed);
+            return;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    unlink(old, scope);
+    --oldCount;
+}
+
+
+size_t Collector::collect(bool full) {
+    auto start = std::chrono::steady_clock::now();
+    // the variables of garbage scopes are destroyed once the lock is released, since that frees more scopes
+    std::vector<Scope::Map<Value>> garbage;
+    size_t freedBytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::unique_lock<std::mutex>> youngLocks;
+        std::vector<Scope *> lists{full ? old : nullptr};
+        for (YoungGeneration *generation: generations) {
+            youngLocks.emplace_back(generation->mutex);
+            lists.push_back(generation->scopes);
+        }
+        Tracer tracer;
+        for (Scope *list: lists) {
+            for (Scope *scope = list; scope; scope = scope->nextTracked) {
+                // a scope that isn't owned by a shared_ptr is never garbage
+                long uses = scope->weak_from_this().use_count();
+                tracer.addNode(Tracer::Kind::SCOPE, scope, uses > 0 ? uses : 1, scopeBytes(scope->variables));
+            }
+        }
+        for (size_t i = 0; i < tracer.nodes.size(); ++i) {
+            tracer.expand(i);
+        }
+
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < tracer.nodes.size(); ++i) {
+            if (tracer.nodes[i].references > 0) {
+                tracer.nodes[i].reachable = true;
+                pending.push_back(i);
+            }
+        }
+        while (!pending.empty()) {
+            const Tracer::Node &node = tracer.nodes[pending.back()];
+            pending.pop_back();
+            for (size_t e = node.firstEdge; e < node.firstEdge + node.edgeCount; ++e) {
+                Tracer::Node &target = tracer.nodes[tracer.edges[e]];
+                if (!target.reachable) {
+                    target.reachable = true;
+                    pending.push_back(tracer.edges[e]);
+                }
+            }
+        }
+
+        size_t tracedBytes = 0;
+        for (const auto &node: tracer.nodes) {
+            tracedBytes += node.bytes;
+            if (node.reachable) {
+                continue;
+            }
+            freedBytes += node.bytes;
+            if (node.kind == Tracer::Kind::SCOPE) {
+                auto scope = const_cast<Scope *>(static_cast<const Scope *>(node.object));
+                for (const auto &[name, value]: scope->variables) {
+                    scope->countCallable(name, value.isFunction(), false);
+                }
+                garbage.push_back(std::move(scope->variables));
+                scope->variables.clear();
+            }
+        }
+
+        for (YoungGeneration *generation: generations) {
+            while (Scope *scope = generation->scopes) {
+                unlink(generation->scopes, scope);
+                scope->generation = nullptr;
+                link(old, scope);
+                ++oldCount;
+            }
+            generation->count.store(0, std::memory_order_relaxed);
+        }
+
+        ++stats.collections;
+        stats.collectedScopes += garbage.size();
+        stats.collectedBytes += freedBytes;
+        if (full) {
+            ++stats.fullCollections;
+            stats.heapBytes = tracedBytes - freedBytes;
+            oldAfterFull = oldCount - garbage.size();
+        }
+    }
+    size_t freed = garbage.size();
+    garbage.clear();
+
+    auto pause = std::chrono::steady_clock::now() - start;
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.totalPause += pause;
+    stats.longestPause = std::max(stats.longestPause, std::chrono::duration_cast<std::chrono::nanoseconds>(pause));
+    return freed;
+}
+
+
+void Collector::collectIfDue() {
+    if (ThreadPool::inTask()) {
+        return;
+    }
+    YoungGeneration *generation = threadGeneration();
+    if (!generation || generation->count.load(std::memory_order_relaxed) < YOUNG_LIMIT) {
+        return;
+    }
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        full = oldCount > oldAfterFull + oldAfterFull / 4;
+    }
+    collect(full);
+}
+
+
+size_t Collector::collectAll() {
+    if (ThreadPool::inTask()) {
+        return 0;
+    }
+    return collect(true);
+}
+
+
+Collector::Stats Collector::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats current = stats;
+    current.liveScopes = oldCount;
+    for (YoungGeneration *generation: generations) {
+        current.liveScopes += generation->count.load(std::memory_order_relaxed);
+    }
+    return current;
+}
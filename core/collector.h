@@ -0,0 +1,138 @@
+#ifndef CPP_INTERPRETER_COLLECTOR_H
+#define CPP_INTERPRETER_COLLECTOR_H
+
+#include "value.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+
+class Scope;
+
+// what a collection looks at: scopes, and the list, dictionary, iterator and function payloads reachable from them.
+// other objects call visit() once for every reference they hold to one of these
+class Tracer {
+private:
+    friend class Collector;
+
+    enum class Kind { SCOPE, LIST, DICT, ITERATOR, CLOSURE };
+
+    struct Node {
+        Kind kind;
+        const void *object;
+        // references from outside the traced objects, once every traced reference is subtracted
+        long references;
+        size_t bytes;
+        size_t firstEdge = 0, edgeCount = 0;
+        bool reachable = false;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<size_t> edges;
+    std::unordered_map<const void *, size_t> index;
+    // the node whose references are being visited
+    size_t current = 0;
+
+    void addNode(Kind kind, const void *object, long references, size_t bytes);
+
+    // records a reference from the current node. Only scopes that are already nodes are followed, so a young
+    // collection never wanders into the old generation
+    void edge(Kind kind, const void *object, long useCount, size_t bytes);
+
+    void expand(size_t node);
+
+    Tracer() = default;
+
+public:
+    void visit(const std::shared_ptr<Scope> &scope);
+
+    void visit(const std::shared_ptr<ValueList> &list);
+
+    void visit(const std::shared_ptr<ValueDict> &dict);
+
+    void visit(const std::shared_ptr<ValueIterator> &iterator);
+
+    void visit(const std::shared_ptr<const Closure> &closure);
+
+    void visit(const Value &value) { value.trace(*this); }
+};
+
+// the young scopes one thread made. Only that thread adds to it, but the thread that frees a scope takes it out, so it
+// has a lock of its own, which threads almost never wait for. Whatever is left when the thread exits becomes old
+struct YoungGeneration {
+    std::mutex mutex;
+    Scope *scopes = nullptr;
+    // written under the lock, read without it to decide whether a collection is due
+    std::atomic<size_t> count{0};
+
+    YoungGeneration();
+
+    ~YoungGeneration();
+};
+
+// finds scopes that are only kept alive by reference cycles and breaks the cycles by clearing their variables.
+// lists and dictionaries are copied on write, so they can't refer back to themselves, but an unfinished generator or
+// a map() or filter() iterator keeps a scope alive, and a variable of that same scope can hold the iterator.
+// collection is trial deletion: a scope or payload whose use count is fully explained by references from other
+// traced objects is garbage unless it can be reached from one that isn't.
+// scopes start out young, in a generation per thread. Once enough young scopes of the collecting thread are alive, only
+// the young scopes of every thread are collected, and the survivors become old.
+// the old ones are collected along with them once they grew by a quarter since the last full collection, which keeps
+// most pauses down to the size of the young generation. This takes the place of an incremental mode: trial deletion
+// needs every use count to hold still while it runs, so a full collection traces all live scopes in one pause
+class Collector {
+public:
+    struct Stats {
+        size_t collections = 0;
+        size_t fullCollections = 0;
+        size_t collectedScopes = 0;
+        // estimated from the sizes of scopes and containers
+        size_t collectedBytes = 0;
+        std::chrono::nanoseconds totalPause{0};
+        std::chrono::nanoseconds longestPause{0};
+        size_t liveScopes = 0;
+        // the estimated size of everything the last full collection traced
+        size_t heapBytes = 0;
+    };
+
+private:
+    static constexpr size_t YOUNG_LIMIT = 2000;
+
+    friend struct YoungGeneration;
+
+    // guards the old generation, the list of young generations and the stats. It is taken before any young
+    // generation's lock
+    std::mutex mutex;
+    std::vector<YoungGeneration *> generations;
+    Scope *old = nullptr;
+    size_t oldCount = 0, oldAfterFull = 0;
+    Stats stats;
+
+    Collector() = default;
+
+    static void link(Scope *&list, Scope *scope);
+
+    static void unlink(Scope *&list, Scope *scope);
+
+    size_t collect(bool full);
+
+public:
+    static Collector &instance();
+
+    void track(Scope *scope);
+
+    void untrack(Scope *scope);
+
+    // runs a young or full collection if either generation is due for one. Only call this where every scope the
+    // interpreter is using is held by a shared_ptr
+    void collectIfDue();
+
+    // a full collection; returns the number of scopes freed. Does nothing inside a parallel builtin's task
+    size_t collectAll();
+
+    Stats getStats();
+};
+
+
+#endif
@@ -0,0 +1,201 @@
+#include "../util/errors.h"
+#include "../util/profiler.h"
+#include "heap.h"
+#include "scope.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+
+bool heapProfiling = false;
+
+struct Allocation {
+    PayloadKind kind;
+    // where it was made: the innermost function, or the script, and its line
+    uint32_t label;
+    uint32_t line;
+};
+
+static std::mutex mutex;
+static std::unordered_map<const void *, Allocation> live;
+
+static constexpr uint32_t NO_SITE = UINT32_MAX;
+
+static const char *kindNames[] = {"string", "list", "dict"};
+
+
+size_t payloadBytes(const SharedString &str) {
+    const auto &text = std::get<std::string>(str.base);
+    // short strings are stored inside the string object
+    return sizeof(SharedString) + (text.capacity() > 15 ? text.capacity() + 1 : 0);
+}
+
+
+size_t payloadBytes(const ValueList &list) {
+    size_t element = list.boxed() ? sizeof(Value) : list.bools() ? 0 : sizeof(long);
+    return sizeof(ValueList) + (element ? list.capacity() * element : list.capacity() / 8);
+}
+
+
+size_t payloadBytes(const ValueDict &dict) {
+    return sizeof(ValueDict) + dict.size() * (sizeof(ValueDict::Entry) + 2 * sizeof(uint32_t));
+}
+
+
+static size_t allocationBytes(const void *payload, PayloadKind kind) {
+    switch (kind) {
+        case PayloadKind::STRING: return payloadBytes(*static_cast<const SharedString *>(payload));
+        case PayloadKind::LIST: return payloadBytes(*static_cast<const ValueList *>(payload));
+        case PayloadKind::DICT: return payloadBytes(*static_cast<const ValueDict *>(payload));
+    }
+    return 0;
+}
+
+
+void trackPayload(const void *payload, PayloadKind kind) {
+    uint32_t depth = callStack.depth;
+    // payloads made outside any function or script, like by a parallel builtin's worker, have no site
+    StackEntry site = depth && depth <= CallStack::MAX_DEPTH ? callStack.entries[depth - 1] : StackEntry{NO_SITE, 0};
+    std::lock_guard<std::mutex> lock(mutex);
+    live[payload] = {kind, site.label, site.line};
+}
+
+
+void untrackPayload(const void *payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+    live.erase(payload);
+}
+
+
+void startHeapProfile() {
+    heapProfiling = true;
+}
+
+
+struct HeapContainer {
+    std::string path;
+    PayloadKind kind;
+    const void *payload;
+    size_t bytes;
+};
+
+
+static const size_t LARGEST = 10;
+
+
+// walks the containers a value holds, keeping the largest ones seen so far in descending order
+static void findLargest(const Value &value, const std::string &path, std::unordered_set<const void *> &seen,
+                        std::vector<HeapContainer> &largest) {
+    const void *payload = value.payload();
+    if (!payload || !seen.insert(payload).second || (!value.isList() && !value.isDict())) {
+        return;
+    }
+    HeapContainer container{path, value.isList() ? PayloadKind::LIST : PayloadKind::DICT, payload,
+                        allocationBytes(payload, value.isList() ? PayloadKind::LIST : PayloadKind::DICT)};
+    auto at = std::upper_bound(largest.begin(), largest.end(), container.bytes,
+                               [](size_t bytes, const HeapContainer &other) { return bytes > other.bytes; });
+    if (at - largest.begin() < static_cast<long>(LARGEST)) {
+        largest.insert(at, container);
+        if (largest.size() > LARGEST) {
+            largest.pop_back();
+        }
+    }
+
+    if (value.isList()) {
+        if (const auto *boxed = value.asList().boxed()) {
+            for (size_t i = 0; i < boxed->size(); ++i) {
+                findLargest((*boxed)[i], path + "[" + std::to_string(i) + "]", seen, largest);
+            }
+        }
+    } else {
+        for (const auto &entry: value.asDict()) {
+            findLargest(entry.value, path + "[" + toString(entry.key) + "]", seen, largest);
+        }
+    }
+}
+
+
+static std::string jsonString(const std::string &text) {
+    std::string quoted = "\"";
+    for (char c: text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+    }
+    return quoted + "\"";
+}
+
+
+static std::string siteName(uint32_t label, uint32_t line) {
+    if (label == NO_SITE) {
+        return "<unknown>";
+    }
+    return labelName(label) + ":" + std::to_string(line);
+}
+
+
+size_t writeHeapDump(const std::string &path, const std::shared_ptr<Scope> &scope) {
+    struct Group {
+        size_t count = 0, bytes = 0;
+    };
+    // by site and kind, in a stable order
+    std::map<std::tuple<uint32_t, uint32_t, PayloadKind>, Group> groups;
+    std::unordered_map<const void *, Allocation> sites;
+    size_t total = 0, count = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &[payload, allocation]: live) {
+            size_t bytes = allocationBytes(payload, allocation.kind);
+            Group &group = groups[{allocation.label, allocation.line, allocation.kind}];
+            ++group.count;
+            group.bytes += bytes;
+            total += bytes;
+            ++count;
+        }
+        sites = live;
+    }
+    std::vector<std::pair<std::tuple<uint32_t, uint32_t, PayloadKind>, Group>> bySize(groups.begin(), groups.end());
+    std::stable_sort(bySize.begin(), bySize.end(),
+                     [](const auto &a, const auto &b) { return a.second.bytes > b.second.bytes; });
+
+    const Scope *root = scope.get();
+    while (root->getParent()) {
+        root = root->getParent().get();
+    }
+    std::vector<std::pair<std::string, const Value *>> variables;
+    for (const auto &[name, value]: root->getVariables()) {
+        variables.emplace_back(name, &value);
+    }
+    std::sort(variables.begin(), variables.end());
+    std::unordered_set<const void *> seen;
+    std::vector<HeapContainer> largest;
+    for (const auto &[name, value]: variables) {
+        findLargest(*value, name, seen, largest);
+    }
+
+    std::ofstream file(path);
+    if (!file) {
+        throw ValueError("Function heapdump() cannot write to " + path);
+    }
+    file << "{\n  \"profiling\": " << (heapProfiling ? "true" : "false") << ",\n  \"live_bytes\": " << total
+         << ",\n  \"live_payloads\": " << count << ",\n  \"sites\": [";
+    for (size_t i = 0; i < bySize.size(); ++i) {
+        const auto &[label, line, kind] = bySize[i].first;
+        file << (i ? ",\n" : "\n") << "    {\"site\": " << jsonString(siteName(label, line)) << ", \"type\": \""
+             << kindNames[static_cast<int>(kind)] << "\", \"count\": " << bySize[i].second.count << ", \"bytes\": "
+             << bySize[i].second.bytes << '}';
+    }
+    file << "\n  ],\n  \"largest\": [";
+    for (size_t i = 0; i < largest.size(); ++i) {
+        auto site = sites.find(largest[i].payload);
+        file << (i ? ",\n" : "\n") << "    {\"path\": " << jsonString(largest[i].path) << ", \"type\": \""
+             << kindNames[static_cast<int>(largest[i].kind)] << "\", \"bytes\": " << largest[i].bytes << ", \"site\": "
+             << (site != sites.end() ? jsonString(siteName(site->second.label, site->second.line)) : "null") << '}';
+    }
+    file << "\n  ]\n}\n";
+    return total;
+}
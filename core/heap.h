@@ -0,0 +1,54 @@
+#ifndef CPP_INTERPRETER_HEAP_H
+#define CPP_INTERPRETER_HEAP_H
+
+#include "value.h"
+#include <string>
+
+
+class Scope;
+
+// true once the heap profiler runs, which is decided before the program starts and never changes
+extern bool heapProfiling;
+
+enum class PayloadKind { STRING, LIST, DICT };
+
+// estimated sizes of payloads, counting what they allocate themselves but not the payloads they hold
+size_t payloadBytes(const SharedString &str);
+
+size_t payloadBytes(const ValueList &list);
+
+size_t payloadBytes(const ValueDict &dict);
+
+// remembers a new payload together with the function and line that created it, until it is deleted
+void trackPayload(const void *payload, PayloadKind kind);
+
+void untrackPayload(const void *payload);
+
+// the deleter of payloads made while profiling, so the profiler hears when they go away
+struct UntrackingDelete {
+    template<typename Payload>
+    void operator()(Payload *payload) const {
+        untrackPayload(payload);
+        delete payload;
+    }
+};
+
+// a shared string, list or dictionary payload; tracked if the heap profiler runs
+template<typename Payload, typename... Args>
+std::shared_ptr<Payload> makePayload(PayloadKind kind, Args &&...args) {
+    if (!heapProfiling) {
+        return std::make_shared<Payload>(std::forward<Args>(args)...);
+    }
+    std::shared_ptr<Payload> payload(new Payload(std::forward<Args>(args)...), UntrackingDelete());
+    trackPayload(payload.get(), kind);
+    return payload;
+}
+
+void startHeapProfile();
+
+// writes the live payloads' bytes and counts per allocation site and kind, and the largest containers reachable from
+// the root of the scope, as JSON. Returns the live bytes of all tracked payloads
+size_t writeHeapDump(const std::string &path, const std::shared_ptr<Scope> &scope);
+
+
+#endif
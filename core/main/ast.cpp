@@ -1,7 +1,11 @@
 #include "../../util/errors.h"
+#include "../../util/fuel.h"
 #include "../../util/functions.h"
+#include "../../util/heatmap.h"
+#include "../../util/trace.h"
 #include "../../util/utf8string.h"
 #include "ast.h"
+#include "generator.h"
 
 
 std::unique_ptr<ASTNode> FloatNode::clone() const {
@@ -9,6 +13,7 @@ std::unique_ptr<ASTNode> FloatNode::clone() const {
 }
 
 Value FloatNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::FLOAT);
     return Value(value);
 }
 
@@ -18,6 +23,7 @@ std::unique_ptr<ASTNode> IntNode::clone() const {
 }
 
 Value IntNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::INT);
     return Value(value);
 }
 
@@ -27,6 +33,7 @@ std::unique_ptr<ASTNode> StringNode::clone() const {
 }
 
 Value StringNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::STRING);
     return Value(value);
 }
 
@@ -36,6 +43,7 @@ std::unique_ptr<ASTNode> BoolNode::clone() const {
 }
 
 Value BoolNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::BOOL);
     return Value(value);
 }
 
@@ -130,6 +138,7 @@ bool toBool(const Value &value, bool qmark) {
 }
 
 Value TypeCastNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::TYPE_CAST);
     auto value = var->evaluate(scope);
     switch (type) {
         case TokenType::INT_T:
@@ -151,7 +160,8 @@ std::unique_ptr<ASTNode> UnaryOpNode::clone() const {
 }
 
 Value UnaryOpNode::evaluate(std::shared_ptr<Scope> scope) const {
-    auto operandValue = operand->evaluate(scope);
+    countNode(NodeKind::UNARY_OP);
+    const auto operandValue = operand->evaluate(scope);
     switch (op) {
         case TokenType::NOT:
             if (operandValue.isBase() && std::holds_alternative<bool>(operandValue.asBase())) {
@@ -160,7 +170,7 @@ Value UnaryOpNode::evaluate(std::shared_ptr<Scope> scope) const {
             throw TypeError("NOT operator can only be used with boolean values");
         case TokenType::MINUS:
             if (operandValue.isBase()) {
-                ValueBase base = operandValue.asBase();
+                const ValueBase &base = operandValue.asBase();
                 if (std::holds_alternative<double>(base)) {
                     return Value(-std::get<double>(base));
                 } else if (std::holds_alternative<long>(base)) {
@@ -294,10 +304,7 @@ std::unique_ptr<ASTNode> BinaryOpNode::clone() const {
     return std::make_unique<BinaryOpNode>(op, left->clone(), right->clone());
 }
 
-Value BinaryOpNode::evaluate(std::shared_ptr<Scope> scope) const {
-    auto leftValue = left->evaluate(scope);
-    auto rightValue = right->evaluate(scope);
-
+static Value applyBinaryOp(TokenType op, const Value &leftValue, const Value &rightValue) {
     if (leftValue.isBase() && rightValue.isBase()) {
         const auto &leftBase = leftValue.asBase();
         const auto &rightBase = rightValue.asBase();
@@ -307,12 +314,78 @@ Value BinaryOpNode::evaluate(std::shared_ptr<Scope> scope) const {
     throw InterpreterError("Unexpected binary operator: " + getTypeName(op));
 }
 
+Value BinaryOpNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::BINARY_OP);
+    const auto leftValue = left->evaluate(scope);
+    const auto rightValue = right->evaluate(scope);
+    return applyBinaryOp(op, leftValue, rightValue);
+}
+
 
 std::unique_ptr<ASTNode> AssignmentNode::clone() const {
     return std::make_unique<AssignmentNode>(name, reassign, valueNode->clone());
 }
 
+void AssignmentNode::findAppendedPieces() {
+    if (!reassign) {
+        return;
+    }
+    std::vector<const ASTNode *> pieces;
+    const ASTNode *node = valueNode.get();
+    while (auto *binaryOp = dynamic_cast<const BinaryOpNode *>(node)) {
+        if (binaryOp->getOp() != TokenType::PLUS) {
+            return;
+        }
+        pieces.push_back(binaryOp->getRight().get());
+        node = binaryOp->getLeft().get();
+    }
+    auto *varNode = dynamic_cast<const VariableNode *>(node);
+    if (varNode && varNode->getName() == name && !pieces.empty()) {
+        appendedPieces.assign(pieces.rbegin(), pieces.rend());
+    }
+}
+
+// 's = s + a + b' appends to the string the variable already owns, instead of building a new one per '+'
+Value AssignmentNode::appendToSelf(std::shared_ptr<Scope> scope) const {
+    Value result = scope->getVariable(name);
+    std::vector<Value> pieces;
+    pieces.reserve(appendedPieces.size());
+    for (const auto *piece: appendedPieces) {
+        pieces.push_back(piece->evaluate(scope));
+    }
+    Value *target = scope->findVariable(name);
+
+    auto isString = [](const Value &value) {
+        return value.isBase() && std::holds_alternative<std::string>(value.asBase());
+    };
+    bool allStrings = isString(result);
+    for (const auto &piece: pieces) {
+        allStrings = allStrings && isString(piece);
+    }
+    // evaluating the pieces may have reassigned the variable, maybe to something other than a string; then its current
+    // buffer is not the left operand
+    if (!allStrings || !isString(*target) || &std::as_const(*target).asBase() != &std::as_const(result).asBase()) {
+        for (const auto &piece: pieces) {
+            result = applyBinaryOp(TokenType::PLUS, result, piece);
+        }
+        *target = result;
+        return result;
+    }
+    // dropping our reference leaves the variable as the only owner, so the append below doesn't copy
+    result = Value();
+    auto &buffer = std::get<std::string>(target->asBase());
+    for (const auto &piece: pieces) {
+        buffer += std::get<std::string>(piece.asBase());
+    }
+    target->recharge();
+    return *target;
+}
+
 Value AssignmentNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::ASSIGNMENT);
+    if (!appendedPieces.empty()) {
+        return appendToSelf(scope);
+    }
     Value value = valueNode->evaluate(scope);
     if (reassign) {
         scope->assignVariable(name, value);
@@ -328,7 +401,23 @@ std::unique_ptr<ASTNode> VariableNode::clone() const {
 }
 
 Value VariableNode::evaluate(std::shared_ptr<Scope> scope) const {
-    return scope->getVariable(name);
+    countNode(NodeKind::VARIABLE);
+    if (const Value *variable = scope->findVariable(name)) {
+        return *variable;
+    }
+    // a function's name on its own is a value of that function
+    if (auto func = scope->getFunction(name)) {
+        return makeClosure(name, func, scope);
+    }
+    throw NameError("Unidentified variable: " + name);
+}
+
+Value *VariableNode::evaluateRef(std::shared_ptr<Scope> scope) const {
+    Value *variable = scope->findVariable(name);
+    if (!variable) {
+        throw NameError("Unidentified variable: " + name);
+    }
+    return variable;
 }
 
 
@@ -341,11 +430,13 @@ std::unique_ptr<ASTNode> ListNode::clone() const {
 }
 
 Value ListNode::evaluate(std::shared_ptr<Scope> scope) const {
-    std::vector<Value> result;
+    countNode(NodeKind::LIST);
+    ValueList result;
+    result.reserve(elements.size());
     for (const auto &element: elements) {
         result.push_back(element->evaluate(scope));
     }
-    return Value(result);
+    return Value(std::move(result));
 }
 
 
@@ -358,14 +449,15 @@ std::unique_ptr<ASTNode> DictNode::clone() const {
 }
 
 Value DictNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::DICT);
     ValueDict dict;
+    dict.reserve(elements.size());
     for (const auto &[keyNode, valueNode]: elements) {
-        Value key = keyNode->evaluate(scope);
+        const Value key = keyNode->evaluate(scope);
         if (!key.isBase()) {
             throw TypeError("Dictionary key must be a basic type");
         }
-        Value value = valueNode->evaluate(scope);
-        dict[key.asBase()] = std::make_shared<Value>(value);
+        dict[key.asBase()] = valueNode->evaluate(scope);
     }
     return Value(std::move(dict));
 }
@@ -376,8 +468,9 @@ std::unique_ptr<ASTNode> IndexAccessNode::clone() const {
 }
 
 Value IndexAccessNode::evaluate(std::shared_ptr<Scope> scope) const {
-    Value containerValue = container->evaluate(scope);
-    Value indexValue = index->evaluate(scope);
+    countNode(NodeKind::INDEX_ACCESS);
+    const Value containerValue = container->evaluate(scope);
+    const Value indexValue = index->evaluate(scope);
 
     if (containerValue.isList()) {
         if (!indexValue.isBase() || !std::holds_alternative<long>(indexValue.asBase())) {
@@ -387,54 +480,62 @@ Value IndexAccessNode::evaluate(std::shared_ptr<Scope> scope) const {
         if (idx >= containerValue.asList().size() || idx < 0) {
             throw IndexError("Index (" + std::to_string(idx) + ") out of range");
         }
-        return *containerValue.asList()[idx];
+        return containerValue.asList().get(idx);
     } else if (containerValue.isDict()) {
         if (!indexValue.isBase()) {
             throw TypeError("Dictionary key must be a basic type");
         }
-        auto &dict = containerValue.asDict();
-        auto it = dict.find(indexValue.asBase());
-        if (it == dict.end()) {
+        const Value *found = containerValue.asDict().find(indexValue.asBase());
+        if (!found) {
             throw NameError("Key '" + toString(indexValue.asBase()) + "' not found in the dictionary");
         }
-        return *it->second;
+        return *found;
     } else if (std::holds_alternative<std::string>(containerValue.asBase())) {
         auto &s = std::get<std::string>(containerValue.asBase());
         if (!indexValue.isBase() || !std::holds_alternative<long>(indexValue.asBase())) {
             throw TypeError("String index must be an integer");
         }
         long idx = std::get<long>(indexValue.asBase());
-        if (idx >= getStrLen(s) || idx < 0) {
+        const Utf8Index &chars = containerValue.strIndex();
+        if (idx < 0 || idx >= chars.charCount(s)) {
             throw IndexError("Index (" + std::to_string(idx) + ") out of range");
         }
-        return Value(getStrChar(s, idx));
+        return Value(chars.charAt(s, idx));
     } else {
         throw TypeError("Indexing can only be performed on lists, dictionaries and strings");
     }
 }
 
 
-void updateNestedContainer(const std::unique_ptr<ASTNode> &node, const Value &updated, std::shared_ptr<Scope> scope) {
-    if (auto *indexAccessNode = dynamic_cast<const IndexAccessNode *>(node.get())) {
-        Value parentContainerValue = indexAccessNode->getContainer()->evaluate(scope);
-        Value indexValue = indexAccessNode->getIndex()->evaluate(scope);
+Value *IndexAccessNode::evaluateRef(std::shared_ptr<Scope> scope) const {
+    // the index goes first: evaluating it may run user code, which must not see half-resolved storage
+    const Value indexValue = index->evaluate(scope);
+    Value *containerRef = container->evaluateRef(scope);
+    if (!containerRef) {
+        return nullptr;
+    }
 
-        if (parentContainerValue.isList()) {
-            if (!indexValue.isBase() || !std::holds_alternative<long>(indexValue.asBase())) {
-                throw TypeError("List index must be an integer");
-            }
-            auto idx = static_cast<size_t>(std::get<long>(indexValue.asBase()));
-            parentContainerValue.updateListElement(idx, updated);
-        } else if (parentContainerValue.isDict()) {
-            if (!indexValue.isBase()) {
-                throw TypeError("Dictionary key must be a basic type");
-            }
-            parentContainerValue.setDictElement(indexValue.asBase(), updated);
+    if (containerRef->isList()) {
+        if (!indexValue.isBase() || !std::holds_alternative<long>(indexValue.asBase())) {
+            throw TypeError("List index must be an integer");
+        }
+        long idx = std::get<long>(indexValue.asBase());
+        if (idx >= containerRef->asList().size() || idx < 0) {
+            throw IndexError("Index (" + std::to_string(idx) + ") out of range");
         }
-        updateNestedContainer(indexAccessNode->getContainer(), parentContainerValue, scope);
-    } else if (auto *varNode = dynamic_cast<const VariableNode *>(node.get())) {
-        scope->assignVariable(varNode->getName(), updated);
+        return containerRef->asList().getRef(idx);
+    } else if (containerRef->isDict()) {
+        if (!indexValue.isBase()) {
+            throw TypeError("Dictionary key must be a basic type");
+        }
+        Value *found = containerRef->asDict().find(indexValue.asBase());
+        if (!found) {
+            throw NameError("Key '" + toString(indexValue.asBase()) + "' not found in the dictionary");
+        }
+        return found;
     }
+    // characters of a string are not assignable
+    return nullptr;
 }
 
 
@@ -443,30 +544,37 @@ std::unique_ptr<ASTNode> IndexAssignmentNode::clone() const {
 }
 
 Value IndexAssignmentNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::INDEX_ASSIGNMENT);
     auto *indexAccessNode = dynamic_cast<IndexAccessNode *>(access.get());
     if (!indexAccessNode) {
         throw InterpreterError("Invalid index assignment");
     }
 
-    Value containerValue = indexAccessNode->getContainer()->evaluate(scope);
-    Value indexValue = indexAccessNode->getIndex()->evaluate(scope);
+    const Value indexValue = indexAccessNode->getIndex()->evaluate(scope);
     Value newValue = value->evaluate(scope);
 
-    if (containerValue.isList()) {
+    // resolved last, so no user code runs between locating the storage and writing to it
+    Value temporary;
+    Value *containerRef = indexAccessNode->getContainer()->evaluateRef(scope);
+    if (!containerRef) {
+        temporary = indexAccessNode->getContainer()->evaluate(scope);
+        containerRef = &temporary;
+    }
+
+    if (containerRef->isList()) {
         if (!indexValue.isBase() || !std::holds_alternative<long>(indexValue.asBase())) {
             throw TypeError("List index must be an integer");
         }
         long idx = std::get<long>(indexValue.asBase());
-        containerValue.updateListElement(idx, newValue);
-    } else if (containerValue.isDict()) {
+        containerRef->updateListElement(idx, newValue);
+    } else if (containerRef->isDict()) {
         if (!indexValue.isBase()) {
             throw TypeError("Dictionary key must be a basic type");
         }
-        containerValue.setDictElement(indexValue.asBase(), newValue);
+        containerRef->setDictElement(indexValue.asBase(), newValue);
     } else {
         throw TypeError("Index assignment can only be performed on lists and dictionaries");
     }
-    updateNestedContainer(indexAccessNode->getContainer(), containerValue, scope);
     return newValue;
 }
 
@@ -479,46 +587,90 @@ std::unique_ptr<ASTNode> MethodCallNode::clone() const {
     return std::make_unique<MethodCallNode>(container->clone(), methodName, std::move(clonedArguments));
 }
 
+static bool isMutatingMethod(const std::string &name) {
+    return name == "append" || name == "remove" || name == "put" || name == "sort" || name == "ltrim" ||
+           name == "rtrim" || name == "replace";
+}
+
 Value MethodCallNode::evaluate(std::shared_ptr<Scope> scope) const {
-    Value containerValue = container->evaluate(scope);
+    countNode(NodeKind::METHOD_CALL);
+    std::vector<Value> argValues;
+    argValues.reserve(arguments.size());
+    for (const auto &arg: arguments) {
+        argValues.push_back(arg->evaluate(scope));
+    }
 
-    if (containerValue.isList()) {
-        if (methodName == "len") {
-            return listlen(containerValue, arguments);
-        } else if (methodName == "append") {
-            listappend(containerValue, arguments, scope);
+    if (!isMutatingMethod(methodName)) {
+        const Value containerValue = container->evaluate(scope);
+        if (containerValue.isList()) {
+            if (methodName == "len") {
+                return listlen(containerValue, argValues);
+            }
+            throw NameError("Unknown list method: " + methodName);
+        } else if (containerValue.isDict()) {
+            if (methodName == "size") {
+                return dictsize(containerValue, argValues);
+            } else if (methodName == "exists") {
+                return dictexists(containerValue, argValues);
+            }
+            throw NameError("Unknown dictionary method: " + methodName);
+        } else if (containerValue.isBase() && std::holds_alternative<std::string>(containerValue.asBase())) {
+            if (methodName == "len") {
+                return slen(containerValue, argValues);
+            } else if (methodName == "find") {
+                return sfind(containerValue, argValues);
+            } else if (methodName == "startswith") {
+                return sstartswith(containerValue, argValues);
+            } else if (methodName == "split") {
+                return ssplit(containerValue, argValues);
+            } else if (methodName == "join") {
+                return sjoin(containerValue, argValues);
+            }
+            throw NameError("Unknown string method: " + methodName);
+        }
+        throw TypeError("Methods can only be called on lists, dictionaries and strings");
+    }
+
+    // mutating methods work on the caller's storage directly; non-assignable callers are mutated as temporaries
+    Value temporary;
+    Value *caller = container->evaluateRef(scope);
+    if (!caller) {
+        temporary = container->evaluate(scope);
+        caller = &temporary;
+    }
+
+    if (caller->isList()) {
+        if (methodName == "append") {
+            listappend(*caller, argValues);
         } else if (methodName == "remove") {
-            listremove(containerValue, arguments, scope);
+            listremove(*caller, argValues);
         } else if (methodName == "put") {
-            listput(containerValue, arguments, scope);
+            listput(*caller, argValues);
+        } else if (methodName == "sort") {
+            listsort(*caller, argValues);
         } else {
             throw NameError("Unknown list method: " + methodName);
         }
-    } else if (containerValue.isDict()) {
-        if (methodName == "size") {
-            return dictsize(containerValue, arguments);
-        } else if (methodName == "remove") {
-            dictremove(containerValue, arguments, scope);
-        } else if (methodName == "exists") {
-            return dictexists(containerValue, arguments, scope);
+    } else if (caller->isDict()) {
+        if (methodName == "remove") {
+            dictremove(*caller, argValues);
         } else {
             throw NameError("Unknown dictionary method: " + methodName);
         }
-    } else if (containerValue.isBase() && std::holds_alternative<std::string>(containerValue.asBase())) {
-        if (methodName == "len") {
-            return slen(containerValue, arguments);
-        } else if (methodName == "ltrim") {
-            sltrim(containerValue, arguments, scope);
+    } else if (caller->isBase() && std::holds_alternative<std::string>(std::as_const(*caller).asBase())) {
+        if (methodName == "ltrim") {
+            sltrim(*caller, argValues);
         } else if (methodName == "rtrim") {
-            srtrim(containerValue, arguments, scope);
+            srtrim(*caller, argValues);
+        } else if (methodName == "replace") {
+            sreplace(*caller, argValues);
         } else {
             throw NameError("Unknown string method: " + methodName);
         }
     } else {
         throw TypeError("Methods can only be called on lists, dictionaries and strings");
     }
-    updateNestedContainer(container, containerValue, scope);
-    return containerValue;
+    return *caller;
 }
 
 
@@ -527,16 +679,20 @@ std::unique_ptr<ASTNode> BlockNode::clone() const {
 }
 
 Value BlockNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::BLOCK);
+    if (statements.empty()) {
+        return Value();
+    }
     auto blockScope = scope->createChildScope();
-    Value lastValue;
-    for (const auto &statement: statements) {
-        try {
-            lastValue = statement->evaluate(blockScope);
-        } catch (const ReturnException &e) {
-            throw;
-        }
+    // intermediate results are dropped right away, so they never pin a container the next statement mutates
+    for (size_t i = 0; i < statements.size() - 1; ++i) {
+        setCurrentLine(statements[i]->getLine());
+        LineProbe probe(*statements[i]);
+        statements[i]->evaluate(blockScope);
     }
-    return lastValue;
+    setCurrentLine(statements.back()->getLine());
+    LineProbe probe(*statements.back());
+    return statements.back()->evaluate(blockScope);
 }
 
 
@@ -546,6 +702,7 @@ std::unique_ptr<ASTNode> IfElseNode::clone() const {
 }
 
 Value IfElseNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::IF_ELSE);
     Value cond = condition->evaluate(scope);
     if (cond.isBase() && std::holds_alternative<bool>(cond.asBase())) {
         if (std::get<bool>(cond.asBase())) {
@@ -568,45 +725,54 @@ std::unique_ptr<ASTNode> ForLoopNode::clone() const {
     if (!clonedStartExpr || !clonedBody) {
         throw std::runtime_error("Cannot clone a ForLoopNode without cloning startExpr and body");
     }
-    return std::make_unique<ForLoopNode>(variableName, std::move(clonedStartExpr), std::move(clonedEndExpr),
-                                         std::move(clonedStepExpr), std::move(clonedBody), isRangeLoop);
+    return std::make_unique<ForLoopNode>(variableName, valueName, std::move(clonedStartExpr),
+                                         std::move(clonedEndExpr), std::move(clonedStepExpr), std::move(clonedBody),
+                                         isRangeLoop);
 }
 
-Value ForLoopNode::evaluate(std::shared_ptr<Scope> scope) const {
-    auto loopScope = scope->createChildScope();
-    Value lastValue;
+void ForLoopNode::evaluateRange(std::shared_ptr<Scope> scope, long &start, long &end, long &step) const {
+    const Value startValue = startExpr->evaluate(scope);
+    const Value endValue = endExpr->evaluate(scope);
 
-    if (isRangeLoop) {
-        Value startValue = startExpr->evaluate(scope);
-        Value endValue = endExpr->evaluate(scope);
+    if (!startValue.isBase() || !std::holds_alternative<long>(startValue.asBase()) ||
+        !endValue.isBase() || !std::holds_alternative<long>(endValue.asBase())) {
+        throw TypeError("Loop range must be integers");
+    }
 
-        if (!startValue.isBase() || !std::holds_alternative<long>(startValue.asBase()) ||
-            !endValue.isBase() || !std::holds_alternative<long>(endValue.asBase())) {
-            throw TypeError("Loop range must be integers");
+    start = std::get<long>(startValue.asBase());
+    end = std::get<long>(endValue.asBase());
+
+    if (stepExpr) {
+        const Value stepValue = stepExpr->evaluate(scope);
+        if (!stepValue.isBase() || !std::holds_alternative<long>(stepValue.asBase())) {
+            throw TypeError("Loop step must be an integer");
+        }
+        step = std::get<long>(stepValue.asBase());
+        if (step == 0) {
+            throw ValueError("Loop step cannot be zero");
         }
+    } else {
+        step = (start <= end) ? 1 : -1;
+    }
 
-        long start = std::get<long>(startValue.asBase());
-        long end = std::get<long>(endValue.asBase());
-        long step;
+    if ((step > 0 && start > end) || (step < 0 && start < end)) {
+        throw ValueError("Invalid loop range and step combination");
+    }
+}
 
-        if (stepExpr) {
-            Value stepValue = stepExpr->evaluate(scope);
-            if (!stepValue.isBase() || !std::holds_alternative<long>(stepValue.asBase())) {
-                throw TypeError("Loop step must be an integer");
-            }
-            step = std::get<long>(stepValue.asBase());
-            if (step == 0) {
-                throw ValueError("Loop step cannot be zero");
-            }
-        } else {
-            step = (start <= end) ? 1 : -1;
-        }
+Value ForLoopNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::FOR_LOOP);
+    auto loopScope = scope->createChildScope();
+    Value lastValue;
 
-        if ((step > 0 && start > end) || (step < 0 && start < end)) {
-            throw ValueError("Invalid loop range and step combination");
-        }
+    if (isRangeLoop) {
+        long start, end, step;
+        evaluateRange(scope, start, end, step);
         for (long i = start; (step > 0) ? (i <= end) : (i >= end); i += step) {
+            burnFuel();
             loopScope->setVariable(variableName, Value(i));
+            // release the previous iteration's result before the body can mutate what it refers to
+            lastValue = Value();
             try {
                 lastValue = body->evaluate(loopScope);
             } catch (const ControlFlowException &e) {
@@ -615,13 +781,16 @@ Value ForLoopNode::evaluate(std::shared_ptr<Scope> scope) const {
             }
         }
     } else {
-        Value iterableValue = startExpr->evaluate(scope);
-        if (!iterableValue.isDict()) {
-            throw TypeError("Cannot iterate: not a dictionary");
-        }
-        std::vector<ValueBase> keys = iterableValue.getDictKeys();
-        for (const auto &key: keys) {
-            loopScope->setVariable(variableName, Value(key));
+        const bool pairs = !valueName.empty();
+        auto iterator = makeIterator(startExpr->evaluate(scope), pairs);
+        Value element, second;
+        while (iterator->next(element, pairs ? &second : nullptr)) {
+            burnFuel();
+            loopScope->setVariable(variableName, element);
+            if (pairs) {
+                loopScope->setVariable(valueName, second);
+            }
+            lastValue = Value();
             try {
                 lastValue = body->evaluate(loopScope);
             } catch (const ControlFlowException &e) {
@@ -639,23 +808,23 @@ std::unique_ptr<ASTNode> WhileLoopNode::clone() const {
 }
 
 Value WhileLoopNode::evaluate(std::shared_ptr<Scope> scope) const {
-    Value cond = condition->evaluate(scope);
+    countNode(NodeKind::WHILE_LOOP);
     Value lastValue;
-    int maxIterations = 999999;
-
-    if (cond.isBase() && std::holds_alternative<bool>(cond.asBase())) {
-        while (std::get<bool>(cond.asBase()) && maxIterations > 0) {
-            try {
-                lastValue = body->evaluate(scope);
-            } catch (const ControlFlowException &e) {
-                if (e.what() == std::string("BREAK")) break;
-                if (e.what() == std::string("CONTINUE")) continue;
-            }
-            cond = condition->evaluate(scope);
-            maxIterations--;
+    while (true) {
+        Value cond = condition->evaluate(scope);
+        if (!cond.isBase() || !std::holds_alternative<bool>(cond.asBase())) {
+            throw TypeError("Expected boolean expression after 'while'");
+        }
+        if (!std::get<bool>(cond.asBase())) {
+            break;
+        }
+        burnFuel();
+        lastValue = Value();
+        try {
+            lastValue = body->evaluate(scope);
+        } catch (const ControlFlowException &e) {
+            if (e.what() == std::string("BREAK")) break;
         }
-    } else {
-        throw TypeError("Expected boolean expression after 'while'");
     }
     return lastValue;
 }
@@ -666,6 +835,8 @@ std::unique_ptr<ASTNode> ControlFlowNode::clone() const {
 }
 
 Value ControlFlowNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::CONTROL_FLOW);
+    count(Counter::CONTROL_FLOW_EXCEPTIONS);
     if (isBreak) {
         throw ControlFlowException("BREAK");
     } else {
@@ -679,6 +850,8 @@ std::unique_ptr<ASTNode> ReturnNode::clone() const {
 }
 
 Value ReturnNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::RETURN);
+    count(Counter::CONTROL_FLOW_EXCEPTIONS);
     if (expression) {
         Value result = expression->evaluate(scope);
         throw ReturnException(result);
@@ -687,12 +860,24 @@ Value ReturnNode::evaluate(std::shared_ptr<Scope> scope) const {
 }
 
 
+std::unique_ptr<ASTNode> YieldNode::clone() const {
+    return std::make_unique<YieldNode>(expression ? expression->clone() : nullptr);
+}
+
+Value YieldNode::evaluate(std::shared_ptr<Scope> scope) const {
+    countNode(NodeKind::YIELD);
+    throw InterpreterError("'yield' can only be used in a function's body");
+}
+
+
 std::unique_ptr<ASTNode> FunctionDeclarationNode::clone() const {
     return std::make_unique<FunctionDeclarationNode>(*this);
 }
 
 Value FunctionDeclarationNode::evaluate(std::shared_ptr<Scope> scope) const {
-    if (name == "print" || name == "type" || name == "roundf" || name == "round" || name == "floor" || name == "ceil") {
+    countNode(NodeKind::FUNCTION_DECLARATION);
+    const Builtin *builtin = getBuiltinFunction(name);
+    if (builtin && builtin->reserved) {
         throw NameError("Function " + name + "() is a built-in function and cannot be redefined");
     }
     scope->setFunction(name, std::make_shared<FunctionDeclarationNode>(*this));
@@ -709,26 +894,46 @@ std::unique_ptr<ASTNode> FunctionCallNode::clone() const {
 }
 
 Value FunctionCallNode::evaluate(std::shared_ptr<Scope> scope) const {
-    std::shared_ptr<FunctionDeclarationNode> func = scope->getFunction(name);
-    size_t argSize = arguments.size();
-    if (name == "print") {
-        return print(arguments, scope);
-    } else if (name == "type") {
-        return type(arguments, scope);
-    } else if (name == "roundf") {
-        return roundf(arguments, scope);
-    } else if (name == "round") {
-        return roundi(arguments, scope);
-    } else if (name == "floor") {
-        return floori(arguments, scope);
-    } else if (name == "ceil") {
-        return ceili(arguments, scope);
-    } else if (!func) {
+    countNode(NodeKind::FUNCTION_CALL);
+    const Builtin *builtin = getBuiltinFunction(name);
+    // other than a reserved one, a built-in function is hidden by a user's function, or variable holding one, with
+    // the same name
+    const Value *variable = nullptr;
+    std::shared_ptr<FunctionDeclarationNode> func;
+    if (!builtin || !builtin->reserved) {
+        func = scope->findCallable(name, binding, variable);
+    }
+    if (!func && !variable) {
+        if (builtin) {
+            TraceSpan span(TraceSpan::Kind::BUILTIN, label);
+            count(Counter::BUILTIN_CALLS);
+            return builtin->function(arguments, scope);
+        }
         throw NameError("Unidentified function: " + name);
     }
+    // held by value, so the call is unaffected if the arguments reassign the variable
+    const Value closure = variable ? *variable : Value();
+    std::vector<Value> argValues;
+    argValues.reserve(arguments.size());
+    for (const auto &arg: arguments) {
+        argValues.push_back(arg->evaluate(scope));
+    }
+    if (func) {
+        return callFunction(name, func, std::move(argValues), scope);
+    }
+    return callFunction(*closure.asFunction(), std::move(argValues), scope);
+}
+
+
+static Value call(const std::string &name, const std::shared_ptr<FunctionDeclarationNode> &func,
+                  std::vector<Value> arguments, const std::shared_ptr<Scope> &scope, const Closure *closure) {
+    count(Counter::FUNCTION_CALLS);
+    burnFuel();
+    size_t argSize = arguments.size();
 
     bool hasArgs = func->getHasArgs();
-    size_t paramSize = func->getParameters().size();
+    const auto &parameters = func->getParameters();
+    size_t paramSize = parameters.size();
     if (hasArgs && paramSize - 1 > argSize) {
         throw ValueError(
                 "Function " + name + "() expects at least " + std::to_string(paramSize - 1) + " arguments, but got " +
@@ -740,24 +945,30 @@ Value FunctionCallNode::evaluate(std::shared_ptr<Scope> scope) const {
     }
 
     auto childScope = scope->createChildScope();
-    int i;
-    if (paramSize > 0) {
-        for (i = 0; i < paramSize - 1; ++i) {
-            Value argumentValue = arguments[i]->evaluate(scope);
-            childScope->setVariable(func->getParameters()[i], argumentValue);
-        }
-        if (!hasArgs) {
-            Value argumentValue = arguments[i]->evaluate(scope);
-            childScope->setVariable(func->getParameters()[i], argumentValue);
-        } else {
-            std::vector<Value> args;
-            for (int j = i; j < argSize; ++j) {
-                args.push_back(arguments[j]->evaluate(scope));
-            }
-            Value argumentList = Value(args);
-            childScope->setVariable(func->getParameters()[i], argumentList);
+    if (closure) {
+        for (const auto &[captured, declaration]: closure->functions) {
+            childScope->setFunction(captured, declaration);
+        }
+        for (const auto &[captured, value]: closure->captures) {
+            childScope->setVariable(captured, value);
+        }
+    }
+    size_t fixed = hasArgs ? paramSize - 1 : paramSize;
+    for (size_t i = 0; i < fixed; ++i) {
+        childScope->setVariable(parameters[i], arguments[i]);
+    }
+    if (hasArgs) {
+        ValueList args;
+        for (size_t j = fixed; j < argSize; ++j) {
+            args.push_back(arguments[j]);
         }
+        childScope->setVariable(parameters.back(), Value(std::move(args)));
+    }
+    if (func->getIsGenerator()) {
+        return Value(std::make_shared<Generator>(func, childScope));
     }
+    TraceSpan span(TraceSpan::Kind::FUNCTION, func->getLabel());
+    StackFrame frame(func->getLabel());
     try {
         return func->getBody()->evaluate(childScope);
     } catch (const ReturnException &e) {
@@ -765,3 +976,28 @@ Value FunctionCallNode::evaluate(std::shared_ptr<Scope> scope) const {
     }
 }
 
+
+Value callFunction(const std::string &name, const std::shared_ptr<FunctionDeclarationNode> &func,
+                   std::vector<Value> arguments, const std::shared_ptr<Scope> &scope) {
+    return call(name, func, std::move(arguments), scope, nullptr);
+}
+
+
+Value callFunction(const Closure &closure, std::vector<Value> arguments, const std::shared_ptr<Scope> &scope) {
+    return call(closure.name, closure.function, std::move(arguments), scope, &closure);
+}
+
+
+Value makeClosure(const std::string &name, const std::shared_ptr<FunctionDeclarationNode> &func,
+                  const std::shared_ptr<Scope> &scope) {
+    auto closure = std::make_shared<Closure>(Closure{name, func, {}, {}});
+    for (const auto &used: func->getUsedNames()) {
+        if (const Value *variable = scope->findVariable(used)) {
+            closure->captures.emplace_back(used, *variable);
+        } else if (auto declaration = scope->getFunction(used)) {
+            // this includes the function itself if it recurses, so it can still call itself once its scope is gone
+            closure->functions.emplace_back(used, std::move(declaration));
+        }
+    }
+    return Value(std::shared_ptr<const Closure>(std::move(closure)));
+}
@@ -2,6 +2,7 @@
 #define CPP_INTERPRETER_AST_H
 
 #include "../scope.h"
+#include "../../util/profiler.h"
 #include "lexer.h"
 #include <cmath>
 #include <utility>
@@ -9,12 +10,23 @@
 
 
 class ASTNode {
+private:
+    // the source line of a statement, which the profiler reports; 0 for nodes that aren't statements
+    uint32_t line = 0;
+
 public:
     virtual ~ASTNode() = default;
 
+    uint32_t getLine() const { return line; }
+
+    void setLine(uint32_t newLine) { line = newLine; }
+
     virtual std::unique_ptr<ASTNode> clone() const = 0;
 
     virtual Value evaluate(std::shared_ptr<Scope> scope) const = 0;
+
+    // storage the node refers to, so it can be mutated in place; nullptr if the node is not assignable
+    virtual Value *evaluateRef(std::shared_ptr<Scope> scope) const { return nullptr; }
 };
 
 
@@ -132,6 +144,12 @@ public:
     std::unique_ptr<ASTNode> clone() const override;
 
     Value evaluate(std::shared_ptr<Scope> scope) const override;
+
+    TokenType getOp() const { return op; }
+
+    const std::unique_ptr<ASTNode> &getLeft() const { return left; }
+
+    const std::unique_ptr<ASTNode> &getRight() const { return right; }
 };
 
 
@@ -140,10 +158,17 @@ private:
     std::string name;
     bool reassign;
     std::unique_ptr<ASTNode> valueNode;
+    std::vector<const ASTNode *> appendedPieces;   // a, b, ... of 'name = name + a + b ...', empty otherwise
+
+    void findAppendedPieces();
+
+    Value appendToSelf(std::shared_ptr<Scope> scope) const;
 
 public:
     AssignmentNode(std::string name, bool reassign, std::unique_ptr<ASTNode> valueNode)
-            : name(std::move(name)), reassign(reassign), valueNode(std::move(valueNode)) {}
+            : name(std::move(name)), reassign(reassign), valueNode(std::move(valueNode)) {
+        findAppendedPieces();
+    }
 
     std::unique_ptr<ASTNode> clone() const override;
 
@@ -163,6 +188,8 @@ public:
 
     Value evaluate(std::shared_ptr<Scope> scope) const override;
 
+    Value *evaluateRef(std::shared_ptr<Scope> scope) const override;
+
     const std::string &getName() const { return name; }
 };
 
@@ -208,15 +235,14 @@ public:
 
     Value evaluate(std::shared_ptr<Scope> scope) const override;
 
+    Value *evaluateRef(std::shared_ptr<Scope> scope) const override;
+
     const std::unique_ptr<ASTNode> &getContainer() const { return container; }
 
     const std::unique_ptr<ASTNode> &getIndex() const { return index; }
 };
 
 
-void updateNestedContainer(const std::unique_ptr<ASTNode> &node, const Value &updated, std::shared_ptr<Scope> scope);
-
-
 class IndexAssignmentNode : public ASTNode {
 private:
     std::unique_ptr<ASTNode> access;
@@ -260,12 +286,15 @@ public:
     BlockNode(const BlockNode &other) {
         for (const auto &stmt: other.statements) {
             statements.push_back(stmt->clone());
+            statements.back()->setLine(stmt->getLine());
         }
     }
 
     std::unique_ptr<ASTNode> clone() const override;
 
     Value evaluate(std::shared_ptr<Scope> scope) const override;
+
+    const std::vector<std::unique_ptr<ASTNode>> &getStatements() const { return statements; }
 };
 
 
@@ -286,12 +315,20 @@ public:
     std::unique_ptr<ASTNode> clone() const override;
 
     Value evaluate(std::shared_ptr<Scope> scope) const override;
+
+    const std::unique_ptr<ASTNode> &getCondition() const { return condition; }
+
+    const std::unique_ptr<BlockNode> &getIfBlock() const { return ifBlock; }
+
+    const std::unique_ptr<BlockNode> &getElseBlock() const { return elseBlock; }
 };
 
 
 class ForLoopNode : public ASTNode {
 private:
     std::string variableName;
+    // the second variable of 'for key, value in dict', empty otherwise
+    std::string valueName;
     std::unique_ptr<ASTNode> startExpr;
     std::unique_ptr<ASTNode> endExpr;
     std::unique_ptr<ASTNode> stepExpr;
@@ -299,16 +336,29 @@ private:
     bool isRangeLoop;
 
 public:
-    ForLoopNode(std::string variableName, std::unique_ptr<ASTNode> startExpr,
+    ForLoopNode(std::string variableName, std::string valueName, std::unique_ptr<ASTNode> startExpr,
                 std::unique_ptr<ASTNode> endExpr, std::unique_ptr<ASTNode> stepExpr,
                 std::unique_ptr<BlockNode> body, bool isRangeLoop)
-            : variableName(std::move(variableName)), startExpr(std::move(startExpr)),
+            : variableName(std::move(variableName)), valueName(std::move(valueName)), startExpr(std::move(startExpr)),
               endExpr(std::move(endExpr)), stepExpr(std::move(stepExpr)),
               body(std::move(body)), isRangeLoop(isRangeLoop) {}
 
     std::unique_ptr<ASTNode> clone() const override;
 
     Value evaluate(std::shared_ptr<Scope> scope) const override;
+
+    // evaluates and validates the bounds and step of a range loop
+    void evaluateRange(std::shared_ptr<Scope> scope, long &start, long &end, long &step) const;
+
+    const std::string &getVariableName() const { return variableName; }
+
+    const std::string &getValueName() const { return valueName; }
+
+    const std::unique_ptr<ASTNode> &getStartExpr() const { return startExpr; }
+
+    const std::unique_ptr<BlockNode> &getBody() const { return body; }
+
+    bool getIsRangeLoop() const { return isRangeLoop; }
 };
 
 
@@ -326,6 +376,10 @@ public:
     std::unique_ptr<ASTNode> clone() const override;
 
     Value evaluate(std::shared_ptr<Scope> scope) const override;
+
+    const std::unique_ptr<ASTNode> &getCondition() const { return condition; }
+
+    const std::unique_ptr<BlockNode> &getBody() const { return body; }
 };
 
 
@@ -355,21 +409,41 @@ public:
 };
 
 
+// a statement of a generator function's body, which runs through a Generator rather than evaluate()
+class YieldNode : public ASTNode {
+private:
+    std::unique_ptr<ASTNode> expression;
+
+public:
+    explicit YieldNode(std::unique_ptr<ASTNode> expr) : expression(std::move(expr)) {}
+
+    std::unique_ptr<ASTNode> clone() const override;
+
+    Value evaluate(std::shared_ptr<Scope> scope) const override;
+
+    const std::unique_ptr<ASTNode> &getExpression() const { return expression; }
+};
+
+
 class FunctionDeclarationNode : public ASTNode {
 private:
     std::string name;
     std::vector<std::string> parameters;
     bool hasArgs;
-    std::unique_ptr<BlockNode> body;
+    // shared by every copy of the declaration, since the body never changes once parsed
+    std::shared_ptr<BlockNode> body;
+    // true if the body yields; calling the function then returns an iterator over what it yields
+    bool isGenerator;
+    // every other name the body mentions, which a function value captures if it is visible where the value is made
+    std::vector<std::string> usedNames;
+    // what the profiler calls the function's frames
+    uint32_t label;
 
 public:
     FunctionDeclarationNode(std::string name, std::vector<std::string> parameters, bool hasArgs,
-                            std::unique_ptr<BlockNode> body)
-            : name(std::move(name)), parameters(std::move(parameters)), hasArgs(hasArgs), body(std::move(body)) {}
-
-    FunctionDeclarationNode(const FunctionDeclarationNode &other)
-            : name(other.name), parameters(other.parameters), hasArgs(other.hasArgs),
-              body(std::make_unique<BlockNode>(*other.body)) {}
+                            std::unique_ptr<BlockNode> body, bool isGenerator, std::vector<std::string> usedNames)
+            : name(std::move(name)), parameters(std::move(parameters)), hasArgs(hasArgs), body(std::move(body)),
+              isGenerator(isGenerator), usedNames(std::move(usedNames)), label(profileLabel(this->name)) {}
 
     std::unique_ptr<ASTNode> clone() const override;
 
@@ -377,9 +451,15 @@ public:
 
     bool getHasArgs() const { return hasArgs; }
 
+    bool getIsGenerator() const { return isGenerator; }
+
     const std::vector<std::string> &getParameters() const { return parameters; }
 
-    const std::unique_ptr<BlockNode> &getBody() const { return body; }
+    const std::shared_ptr<BlockNode> &getBody() const { return body; }
+
+    const std::vector<std::string> &getUsedNames() const { return usedNames; }
+
+    uint32_t getLabel() const { return label; }
 };
 
 
@@ -387,15 +467,31 @@ class FunctionCallNode : public ASTNode {
 private:
     std::string name;
     std::vector<std::unique_ptr<ASTNode>> arguments;
+    // what the timeline calls the call, if it turns out to be a builtin
+    uint32_t label;
+    // how many scopes below the root bind the name, so the call only walks the scopes while some do
+    const Scope::Binding &binding;
 
 public:
     FunctionCallNode(std::string name, std::vector<std::unique_ptr<ASTNode>> arguments)
-            : name(std::move(name)), arguments(std::move(arguments)) {}
+            : name(std::move(name)), arguments(std::move(arguments)), label(profileLabel(this->name)),
+              binding(Scope::callableBinding(this->name)) {}
 
     std::unique_ptr<ASTNode> clone() const override;
 
     Value evaluate(std::shared_ptr<Scope> scope) const override;
 };
 
+// calls a user-defined function with already evaluated arguments, in a child scope of the caller's scope
+Value callFunction(const std::string &name, const std::shared_ptr<FunctionDeclarationNode> &func,
+                   std::vector<Value> arguments, const std::shared_ptr<Scope> &scope);
+
+// the same for a function value, whose captured variables are bound next to the parameters
+Value callFunction(const Closure &closure, std::vector<Value> arguments, const std::shared_ptr<Scope> &scope);
+
+// a function value for a declaration, capturing the variables it uses that are visible from the scope
+Value makeClosure(const std::string &name, const std::shared_ptr<FunctionDeclarationNode> &func,
+                  const std::shared_ptr<Scope> &scope);
+
 
 #endif
\ No newline at end of file
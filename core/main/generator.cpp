@@ -0,0 +1,167 @@
+#include "../../util/errors.h"
+#include "../../util/fuel.h"
+#include "../../util/heatmap.h"
+#include "../collector.h"
+#include "generator.h"
+
+
+static bool isTrue(const Value &condition, const std::string &keyword) {
+    if (!condition.isBase() || !std::holds_alternative<bool>(condition.asBase())) {
+        throw TypeError("Expected boolean expression after '" + keyword + "'");
+    }
+    return std::get<bool>(condition.asBase());
+}
+
+
+Generator::Generator(std::shared_ptr<FunctionDeclarationNode> function, const std::shared_ptr<Scope> &scope)
+        : function(std::move(function)) {
+    pushBlock(this->function->getBody().get(), scope);
+}
+
+
+void Generator::pushBlock(const BlockNode *block, const std::shared_ptr<Scope> &scope) {
+    Frame frame{FrameType::BLOCK, block, scope->createChildScope()};
+    frames.push_back(std::move(frame));
+}
+
+
+bool Generator::enter(const ASTNode *statement, const std::shared_ptr<Scope> &scope) {
+    if (auto block = dynamic_cast<const BlockNode *>(statement)) {
+        pushBlock(block, scope);
+    } else if (auto ifElse = dynamic_cast<const IfElseNode *>(statement)) {
+        if (isTrue(ifElse->getCondition()->evaluate(scope), "if")) {
+            pushBlock(ifElse->getIfBlock().get(), scope);
+        } else if (ifElse->getElseBlock()) {
+            pushBlock(ifElse->getElseBlock().get(), scope);
+        }
+    } else if (auto forLoop = dynamic_cast<const ForLoopNode *>(statement)) {
+        Frame frame{FrameType::RANGE_LOOP, forLoop, scope->createChildScope()};
+        if (forLoop->getIsRangeLoop()) {
+            forLoop->evaluateRange(scope, frame.current, frame.end, frame.step);
+        } else {
+            frame.type = FrameType::ITERATOR_LOOP;
+            frame.iterator = makeIterator(forLoop->getStartExpr()->evaluate(scope), !forLoop->getValueName().empty());
+        }
+        frames.push_back(std::move(frame));
+    } else if (auto whileLoop = dynamic_cast<const WhileLoopNode *>(statement)) {
+        Frame frame{FrameType::WHILE_LOOP, whileLoop, scope};
+        frames.push_back(std::move(frame));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+bool Generator::advance(Value &element) {
+    Frame &frame = frames.back();
+    if (frame.type != FrameType::BLOCK) {
+        setCurrentLine(frame.node->getLine());
+        burnFuel();
+    }
+    switch (frame.type) {
+        case FrameType::BLOCK: {
+            const auto &statements = static_cast<const BlockNode *>(frame.node)->getStatements();
+            if (frame.statement == statements.size()) {
+                frames.pop_back();
+                return false;
+            }
+            const ASTNode *statement = statements[frame.statement++].get();
+            setCurrentLine(statement->getLine());
+            // entering a statement may push a frame, which invalidates the reference to this one
+            const std::shared_ptr<Scope> scope = frame.scope;
+            LineProbe probe(*statement);
+            if (auto yield = dynamic_cast<const YieldNode *>(statement)) {
+                element = yield->getExpression() ? yield->getExpression()->evaluate(scope) : Value();
+                return true;
+            }
+            if (!enter(statement, scope)) {
+                statement->evaluate(scope);
+            }
+            return false;
+        }
+        case FrameType::RANGE_LOOP: {
+            auto loop = static_cast<const ForLoopNode *>(frame.node);
+            if (frame.step > 0 ? frame.current > frame.end : frame.current < frame.end) {
+                frames.pop_back();
+                return false;
+            }
+            frame.scope->setVariable(loop->getVariableName(), Value(frame.current));
+            frame.current += frame.step;
+            pushBlock(loop->getBody().get(), frame.scope);
+            return false;
+        }
+        case FrameType::ITERATOR_LOOP: {
+            auto loop = static_cast<const ForLoopNode *>(frame.node);
+            const bool pairs = !loop->getValueName().empty();
+            Value key, value;
+            if (!frame.iterator->next(key, pairs ? &value : nullptr)) {
+                frames.pop_back();
+                return false;
+            }
+            frame.scope->setVariable(loop->getVariableName(), key);
+            if (pairs) {
+                frame.scope->setVariable(loop->getValueName(), value);
+            }
+            pushBlock(loop->getBody().get(), frame.scope);
+            return false;
+        }
+        case FrameType::WHILE_LOOP: {
+            auto loop = static_cast<const WhileLoopNode *>(frame.node);
+            if (!isTrue(loop->getCondition()->evaluate(frame.scope), "while")) {
+                frames.pop_back();
+                return false;
+            }
+            pushBlock(loop->getBody().get(), frame.scope);
+            return false;
+        }
+    }
+    return false;
+}
+
+
+// break and continue leave every block up to the innermost loop
+void Generator::unwind(bool isBreak) {
+    while (!frames.empty() && frames.back().type == FrameType::BLOCK) {
+        frames.pop_back();
+    }
+    if (frames.empty()) {
+        throw ControlFlowException(isBreak ? "BREAK" : "CONTINUE");
+    }
+    if (isBreak) {
+        frames.pop_back();
+    }
+}
+
+
+bool Generator::next(Value &element, Value *) {
+    StackFrame frame(function->getLabel());
+    try {
+        while (!frames.empty()) {
+            try {
+                if (advance(element)) {
+                    return true;
+                }
+            } catch (const ControlFlowException &e) {
+                unwind(e.what() == std::string("BREAK"));
+            }
+        }
+    } catch (const ReturnException &) {
+        // a return ends the generator; its value is dropped
+        frames.clear();
+    } catch (...) {
+        frames.clear();
+        throw;
+    }
+    return false;
+}
+
+
+void Generator::traverse(Tracer &tracer) const {
+    for (const auto &frame: frames) {
+        tracer.visit(frame.scope);
+        if (frame.iterator) {
+            frame.iterator->traverse(tracer);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef CPP_INTERPRETER_GENERATOR_H
+#define CPP_INTERPRETER_GENERATOR_H
+
+#include "ast.h"
+
+
+// runs a generator function's body one yield at a time. Blocks, ifs and loops are walked with an explicit stack of
+// frames rather than nested evaluate() calls, so the body can stop at a yield and later resume right after it.
+// all other statements are evaluated as usual
+class Generator : public ValueIterator {
+private:
+    enum class FrameType { BLOCK, RANGE_LOOP, ITERATOR_LOOP, WHILE_LOOP };
+
+    struct Frame {
+        FrameType type = FrameType::BLOCK;
+        const ASTNode *node = nullptr;
+        std::shared_ptr<Scope> scope = nullptr;
+        size_t statement = 0;                               // the next statement of a block
+        long current = 0, end = 0, step = 0;                // the state of a range loop
+        std::unique_ptr<ValueIterator> iterator = nullptr;  // the state of any other for loop
+    };
+
+    std::shared_ptr<FunctionDeclarationNode> function;
+    std::vector<Frame> frames;
+
+    void pushBlock(const BlockNode *block, const std::shared_ptr<Scope> &scope);
+
+    // pushes the frame of a block, if or loop; false for any other statement
+    bool enter(const ASTNode *statement, const std::shared_ptr<Scope> &scope);
+
+    // advances the innermost frame by one statement or iteration; true once it reaches a yield
+    bool advance(Value &element);
+
+    void unwind(bool isBreak);
+
+public:
+    Generator(std::shared_ptr<FunctionDeclarationNode> function, const std::shared_ptr<Scope> &scope);
+
+    bool next(Value &element, Value *second) override;
+
+    void traverse(Tracer &tracer) const override;
+};
+
+
+#endif
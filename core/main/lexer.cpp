@@ -46,6 +46,7 @@ std::string getTypeName(TokenType type) {
         case TokenType::BREAK : return "BREAK";
         case TokenType::CONTINUE : return "CONTINUE";
         case TokenType::RETURN : return "RETURN";
+        case TokenType::YIELD : return "YIELD";
         case TokenType::STOP : return "STOP";
         case TokenType::SEMICOLON : return "SEMICOLON";
         case TokenType::COLON : return "COLON";
@@ -69,6 +70,7 @@ Token Lexer::getNextToken() {
     while (pos < length) {
         if (isspace(input[pos])) {
             if (input[pos++] == '\n') {
+                ++line;
                 return Token(TokenType::EOL);
             }
             continue;
@@ -131,6 +133,9 @@ Token Lexer::getNextToken() {
             } else if (input.substr(pos, 6) == "return" && !std::isalnum(input[pos + 6])) {
                 pos += 6;
                 return Token(TokenType::RETURN);
+            } else if (input.substr(pos, 5) == "yield" && !std::isalnum(input[pos + 5])) {
+                pos += 5;
+                return Token(TokenType::YIELD);
             }
             else if (input.substr(pos, 4) == "stop" && !std::isalnum(input[pos + 4])) {
                 pos += 4;
@@ -254,9 +259,10 @@ Token Lexer::getNextToken() {
 
 
 TokenType Lexer::peekNextTokenType() {
-    size_t tempPos = pos;
+    size_t tempPos = pos, tempLine = line;
     Token token = getNextToken();
     pos = tempPos;
+    line = tempLine;
     return token.getType();
 }
 
@@ -319,5 +325,6 @@ Token Lexer::extractString() {
 void Lexer::reset(const std::string &newInput) {
     input = newInput;
     pos = 0;
+    line = firstLine;
     length = input.length();
 }
@@ -53,6 +53,7 @@ enum class TokenType {
     BREAK,
     CONTINUE,
     RETURN,
+    YIELD,
     STOP,
     // GENERAL
     SEMICOLON,
@@ -86,7 +87,7 @@ public:
 
     TokenType getType() const { return type; }
 
-    Value getValue() const { return value; }
+    const Value &getValue() const { return value; }
 };
 
 
@@ -97,6 +98,9 @@ private:
 
 public:
     size_t pos;
+    // the line pos is on, counting from firstLine
+    size_t line;
+    size_t firstLine = 1;
 
 private:
     Token extractNumber();
@@ -106,7 +110,7 @@ private:
     Token extractString();
 
 public:
-    explicit Lexer(std::string input) : input(std::move(input)), pos(0), length(input.length()) {}
+    explicit Lexer(std::string input) : input(std::move(input)), pos(0), line(1), length(input.length()) {}
 
     void reset(const std::string &newInput);
 
@@ -13,6 +13,12 @@ bool Parser::expectToken(TokenType type) {
 
 void Parser::advanceToken() {
     currentToken = lexer.getNextToken();
+    if (!usedNames.empty() && currentToken.getType() == TokenType::IDENTIFIER) {
+        // a name an inner function uses is also one its enclosing functions have to capture for it
+        for (auto &names: usedNames) {
+            names.insert(std::get<std::string>(currentToken.getValue().asBase()));
+        }
+    }
 }
 
 
@@ -20,7 +26,7 @@ bool Parser::isStatementComplete() {
     int nestedLevel = 0;
     Token tempToken = currentToken;
     TokenType type = tempToken.getType();
-    size_t tempPos = lexer.pos;
+    size_t tempPos = lexer.pos, tempLine = lexer.line;
     bool checkThen = false, checkDo = false, checkAs = false;
 
     while (type != TokenType::END) {
@@ -57,6 +63,7 @@ bool Parser::isStatementComplete() {
             case TokenType::STOP : {
                 if (nestedLevel == 0) {
                     lexer.pos = tempPos;
+                    lexer.line = tempLine;
                     return true;
                 }
                 nestedLevel--;
@@ -72,6 +79,7 @@ bool Parser::isStatementComplete() {
         }
     }
     lexer.pos = tempPos;
+    lexer.line = tempLine;
     return nestedLevel == 0 || checkThen || checkDo || checkAs;
 }
 
@@ -79,7 +87,9 @@ bool Parser::isStatementComplete() {
 
 std::unique_ptr<ASTNode> Parser::parseAssignment(const std::string &name, bool reassign) {
     advanceToken();
+    ++expressionDepth;
     auto valueNode = parseStatement();
+    --expressionDepth;
     return std::make_unique<AssignmentNode>(name, reassign, std::move(valueNode));
 }
 
@@ -188,8 +198,16 @@ std::unique_ptr<ASTNode> Parser::parseForLoop() {
         throw SyntaxError("Expected loop-variable name after 'for'");
     }
     std::string variableName = std::get<std::string>(currentToken.getValue().asBase());
+    std::string valueName;
 
     advanceToken();
+    if (expectToken(TokenType::COMMA)) {
+        if (getType() != TokenType::IDENTIFIER) {
+            throw SyntaxError("Expected second loop-variable name after ','");
+        }
+        valueName = std::get<std::string>(currentToken.getValue().asBase());
+        advanceToken();
+    }
     if (!expectToken(TokenType::IN)) {
         throw SyntaxError("Expected 'in' after loop-variable name");
     }
@@ -200,6 +218,9 @@ std::unique_ptr<ASTNode> Parser::parseForLoop() {
     bool isRangeLoop = false;
 
     if (expectToken(TokenType::DBL_DOT)) {
+        if (!valueName.empty()) {
+            throw SyntaxError("Range loops take a single loop-variable");
+        }
         isRangeLoop = true;
         endExpr = parseLogicalAndOr();
 
@@ -215,8 +236,8 @@ std::unique_ptr<ASTNode> Parser::parseForLoop() {
     if (!expectToken(TokenType::STOP)) {
         throw SyntaxError("Expected 'stop' at the end of for loop");
     }
-    return std::make_unique<ForLoopNode>(variableName, std::move(startExpr), std::move(endExpr), std::move(stepExpr),
-                                         std::move(body), isRangeLoop);
+    return std::make_unique<ForLoopNode>(variableName, valueName, std::move(startExpr), std::move(endExpr),
+                                         std::move(stepExpr), std::move(body), isRangeLoop);
 }
 
 
@@ -270,14 +291,32 @@ std::unique_ptr<ASTNode> Parser::parseFunctionDeclaration() {
     if (!expectToken(TokenType::RPAREN)) {
         throw SyntaxError("Expected ')' after function parameters' names");
     }
+    // the set is in place before 'as' is consumed, since that reads the first token of the body
+    usedNames.emplace_back();
     if (!expectToken(TokenType::AS)) {
         throw SyntaxError("Expected 'as' after function parameters");
     }
+    bool outerSawYield = sawYield;
+    int outerExpressionDepth = expressionDepth;
+    sawYield = false;
+    expressionDepth = 0;
+    ++functionDepth;
     auto body = parseBlock();
+    --functionDepth;
+    bool isGenerator = sawYield;
+    sawYield = outerSawYield;
+    expressionDepth = outerExpressionDepth;
+    std::unordered_set<std::string> names = std::move(usedNames.back());
+    usedNames.pop_back();
+    for (const auto &parameter: parameters) {
+        names.erase(parameter);
+    }
     if (!expectToken(TokenType::STOP)) {
         throw SyntaxError("Expected 'stop' after function body");
     }
-    return std::make_unique<FunctionDeclarationNode>(functionName, std::move(parameters), hasArgs, std::move(body));
+    return std::make_unique<FunctionDeclarationNode>(functionName, std::move(parameters), hasArgs, std::move(body),
+                                                     isGenerator,
+                                                     std::vector<std::string>(names.begin(), names.end()));
 }
 
 
@@ -317,6 +356,11 @@ std::unique_ptr<BlockNode> Parser::parseBlock() {
 
 std::vector<std::unique_ptr<ASTNode>> Parser::parse() {
     std::vector<std::unique_ptr<ASTNode>> statements;
+    // a syntax error may have left these mid-function
+    functionDepth = 0;
+    sawYield = false;
+    expressionDepth = 0;
+    usedNames.clear();
     while (getType() != TokenType::END) {
         if (expectToken(TokenType::EOL) || expectToken(TokenType::SEMICOLON)) {
             continue;
@@ -332,6 +376,14 @@ std::vector<std::unique_ptr<ASTNode>> Parser::parse() {
 }
 
 std::unique_ptr<ASTNode> Parser::parseStatement() {
+    // the line of the statement's first token, which is the one already read
+    auto line = static_cast<uint32_t>(lexer.line);
+    auto statement = parseStatementKind();
+    statement->setLine(line);
+    return statement;
+}
+
+std::unique_ptr<ASTNode> Parser::parseStatementKind() {
     TokenType type = getType();
     switch (type) {
         case TokenType::IF:
@@ -350,10 +402,23 @@ std::unique_ptr<ASTNode> Parser::parseStatement() {
             return std::make_unique<ControlFlowNode>(false);
         case TokenType::RETURN:
             advanceToken();
-            if (getType() == TokenType::SEMICOLON || getType() == TokenType::EOL) {
+            if (getType() == TokenType::SEMICOLON || getType() == TokenType::EOL || getType() == TokenType::STOP) {
                 return std::make_unique<ReturnNode>(nullptr);
             }
             return std::make_unique<ReturnNode>(parseLogicalAndOr());
+        case TokenType::YIELD:
+            if (functionDepth == 0) {
+                throw SyntaxError("'yield' can only be used in a function's body");
+            }
+            if (expressionDepth > 0) {
+                throw SyntaxError("'yield' can only be used as a statement, not inside an expression");
+            }
+            sawYield = true;
+            advanceToken();
+            if (getType() == TokenType::SEMICOLON || getType() == TokenType::EOL || getType() == TokenType::STOP) {
+                return std::make_unique<YieldNode>(nullptr);
+            }
+            return std::make_unique<YieldNode>(parseLogicalAndOr());
         case TokenType::IDENTIFIER: {
             std::string identifierName = std::get<std::string>(currentToken.getValue().asBase());
             TokenType nextType = lexer.peekNextTokenType();
@@ -471,7 +536,9 @@ std::unique_ptr<ASTNode> Parser::parseFactor() {
             }
         }
     } else if (expectToken(TokenType::LPAREN)) {
+        ++expressionDepth;
         node = parseStatement();
+        --expressionDepth;
         if (!expectToken(TokenType::RPAREN)) {
             throw SyntaxError(
                     "Expected closing parentheses ')' but got " + getTypeName(getType()) + " instead");
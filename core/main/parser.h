@@ -2,12 +2,21 @@
 #define CPP_INTERPRETER_PARSER_H
 
 #include "ast.h"
+#include <unordered_set>
 
 
 class Parser {
 private:
     Lexer &lexer;
     std::shared_ptr<Scope> currentScope;
+    // how many function bodies enclose the current statement, and whether the innermost one yields so far
+    int functionDepth = 0;
+    bool sawYield = false;
+    // how many expressions of the innermost function body enclose the current statement, like the value of an
+    // assignment or a parenthesized if. A generator only stops at a yield that is a statement of its own
+    int expressionDepth = 0;
+    // the identifiers read so far in each enclosing function body, innermost last
+    std::vector<std::unordered_set<std::string>> usedNames;
 
 public:
     Token currentToken;
@@ -39,6 +48,8 @@ private:
 
     std::unique_ptr<ASTNode> parseStatement();
 
+    std::unique_ptr<ASTNode> parseStatementKind();
+
     std::unique_ptr<ASTNode> parseLogicalAndOr();
 
     std::unique_ptr<ASTNode> parseComparison();
@@ -1,11 +1,57 @@
 #include "../util/errors.h"
 #include "main/ast.h"
+#include "collector.h"
 #include "scope.h"
+#include <mutex>
+#include <unordered_set>
 #include <utility>
 
 
+static std::mutex bindingMutex;
+
+
+Scope::Binding &Scope::callableBinding(const std::string &name) {
+    std::lock_guard<std::mutex> lock(bindingMutex);
+    // entries are never erased, and the map's nodes don't move, so the reference stays valid
+    static std::unordered_map<std::string, Binding> bindings;
+    return bindings.try_emplace(name, 0).first->second;
+}
+
+
+void Scope::countCallable(const std::string &name, bool before, bool after) const {
+    if (root != this && before != after) {
+        callableBinding(name).fetch_add(after ? 1 : -1, std::memory_order_relaxed);
+    }
+}
+
+
+Scope::Scope() : parent(nullptr), root(this) {
+    count(Counter::SCOPES);
+    Collector::instance().track(this);
+}
+
+
+Scope::Scope(std::shared_ptr<Scope> parent) : parent(std::move(parent)), root(this->parent->root) {
+    count(Counter::SCOPES);
+    Collector::instance().track(this);
+}
+
+
+Scope::~Scope() {
+    Collector::instance().untrack(this);
+    for (const auto &[name, value]: variables) {
+        countCallable(name, value.isFunction(), false);
+    }
+    for (const auto &[name, func]: functions) {
+        countCallable(name, true, false);
+    }
+}
+
+
 void Scope::setVariable(const std::string& name, const Value& value) {
-    variables[name] = value;
+    auto [it, added] = variables.try_emplace(name);
+    countCallable(name, !added && it->second.isFunction(), value.isFunction());
+    it->second = value;
 }
 
 
@@ -37,19 +83,35 @@ Value Scope::getVariable(const std::string& name) const {
 }
 
 
+Value *Scope::findVariable(const std::string& name) {
+    auto it = variables.find(name);
+    if (it != variables.end()) {
+        return &it->second;
+    }
+    if (parent) {
+        return parent->findVariable(name);
+    }
+    return nullptr;
+}
+
+
 void Scope::assignVariable(const std::string& name, const Value& value) {
-    if (hasVariable(name)) {
-        variables[name] = value;
-    } else if (parent) {
-        parent->assignVariable(name, value);
-    } else {
-        throw NameError("Unidentified variable: " + name);
+    for (Scope *scope = this; scope; scope = scope->parent.get()) {
+        auto it = scope->variables.find(name);
+        if (it != scope->variables.end()) {
+            scope->countCallable(name, it->second.isFunction(), value.isFunction());
+            it->second = value;
+            return;
+        }
     }
+    throw NameError("Unidentified variable: " + name);
 }
 
 
 void Scope::setFunction(const std::string& name, std::shared_ptr<FunctionDeclarationNode> func) {
-    functions[name] = std::move(func);
+    auto [it, added] = functions.try_emplace(name);
+    countCallable(name, !added, true);
+    it->second = std::move(func);
 }
 
 
@@ -65,6 +127,47 @@ std::shared_ptr<FunctionDeclarationNode> Scope::getFunction(const std::string& n
 }
 
 
+std::shared_ptr<FunctionDeclarationNode> Scope::findCallable(const std::string& name, const Binding &binding,
+                                                             const Value *&value) const {
+    // with no binding below the root, the scopes in between can't hide what the root binds the name to. A count
+    // changed by another thread only concerns that thread's own scopes, so relaxed loads are enough
+    const Scope *first = binding.load(std::memory_order_relaxed) == 0 ? root : this;
+    for (const Scope *scope = first; scope; scope = scope->parent.get()) {
+        auto func = scope->functions.find(name);
+        if (func != scope->functions.end()) {
+            return func->second;
+        }
+        auto variable = scope->variables.find(name);
+        if (variable != scope->variables.end() && variable->second.isFunction()) {
+            value = &variable->second;
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+
 std::shared_ptr<Scope> Scope::createChildScope() {
-    return std::make_shared<Scope>(shared_from_this());
+    Collector::instance().collectIfDue();
+    return std::allocate_shared<Scope>(Allocator<Scope>(), shared_from_this());
+}
+
+
+std::shared_ptr<Scope> Scope::createIsolatedCopy() const {
+    auto copy = std::allocate_shared<Scope>(Allocator<Scope>());
+    std::unordered_set<std::string> iterators;
+    // the innermost definition of a name wins, so scopes are visited from this one outwards
+    for (const Scope *scope = this; scope; scope = scope->parent.get()) {
+        for (const auto &[name, value]: scope->variables) {
+            if (value.isIterator()) {
+                iterators.insert(name);
+            } else if (!iterators.count(name)) {
+                copy->variables.emplace(name, value);
+            }
+        }
+        for (const auto &[name, func]: scope->functions) {
+            copy->functions.emplace(name, func);
+        }
+    }
+    return copy;
 }
@@ -1,22 +1,61 @@
 #ifndef CPP_INTERPRETER_SCOPE_H
 #define CPP_INTERPRETER_SCOPE_H
 
+#include "../util/pool.h"
 #include "value.h"
+#include <atomic>
 #include <unordered_map>
 
 
 class FunctionDeclarationNode;
+struct YoungGeneration;
 
 class Scope : public std::enable_shared_from_this<Scope> {
+public:
+    // scopes and their entries come from the thread's pool, since most of them only live for one block or call, and
+    // are charged to the memory quota
+    template<typename T>
+    using Allocator = QuotaAllocator<T, PoolAllocator<T>>;
+
+    template<typename T>
+    using Map = std::unordered_map<std::string, T, std::hash<std::string>, std::equal_to<std::string>,
+            Allocator<std::pair<const std::string, T>>>;
+
 private:
-    std::unordered_map<std::string, Value> variables;
-    std::unordered_map<std::string, std::shared_ptr<FunctionDeclarationNode>> functions;
+    Map<Value> variables;
+    Map<std::shared_ptr<FunctionDeclarationNode>> functions;
     std::shared_ptr<Scope> parent;
+    // the outermost scope above this one, or this one if it has no parent
+    Scope *root;
+
+    // the collector's list of live scopes of the same generation
+    friend class Collector;
+    friend class Tracer;
+    friend struct YoungGeneration;
+    Scope *previousTracked = nullptr, *nextTracked = nullptr;
+    // the young generation holding the scope, or nullptr once it is old. Only ever changes from young to old
+    std::atomic<YoungGeneration *> generation = nullptr;
+
+    // keeps the name's binding count right when an entry of a scope below the root starts or stops being callable
+    void countCallable(const std::string &name, bool before, bool after) const;
 
 public:
-    Scope() : parent(nullptr) {}
+    // how many scopes below a root one bind the name to a function, or to a variable holding a function value, right
+    // now, across all threads
+    using Binding = std::atomic<long>;
+
+    // the count for a name. It lives as long as the program, so call sites look it up once when they are parsed
+    static Binding &callableBinding(const std::string &name);
+
+    Scope();
+
+    explicit Scope(std::shared_ptr<Scope> parent);
 
-    explicit Scope(std::shared_ptr<Scope> parent) : parent(std::move(parent)) {}
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+
+    Scope &operator=(const Scope &) = delete;
 
     void setVariable(const std::string &name, const Value &value);
 
@@ -26,13 +65,31 @@ public:
 
     Value getVariable(const std::string &name) const;
 
+    Value *findVariable(const std::string &name);
+
     void assignVariable(const std::string &name, const Value &value);
 
     void setFunction(const std::string &name, std::shared_ptr<FunctionDeclarationNode> func);
 
     std::shared_ptr<FunctionDeclarationNode> getFunction(const std::string &name) const;
 
+    // what a call by this name refers to: the innermost function, or variable holding a function value. A function
+    // wins over a variable in the same scope. Returns nullptr and sets value for a variable; returns nullptr with value
+    // left null if there is neither. While the name's binding count is zero only the root scope can bind it, so that
+    // is the one scope looked at; otherwise the scopes are walked from this one up
+    std::shared_ptr<FunctionDeclarationNode> findCallable(const std::string &name, const Binding &binding,
+                                                          const Value *&value) const;
+
     std::shared_ptr<Scope> createChildScope();
+
+    const std::shared_ptr<Scope> &getParent() const { return parent; }
+
+    const Map<Value> &getVariables() const { return variables; }
+
+    // a new root scope with every variable and function visible from this one, for code running on another thread.
+    // its variables share their contents with the originals until either side writes to them. Iterators are left out,
+    // since every copy of one would advance the same stream
+    std::shared_ptr<Scope> createIsolatedCopy() const;
 };
 
 #endif
@@ -1,14 +1,231 @@
 #include "../util/errors.h"
+#include "collector.h"
+#include "heap.h"
 #include "value.h"
 #include <iostream>
+#include <algorithm>
+#include <utility>
 
 
-Value::Value(const std::vector<Value> &vec) {
-    ValueList shared_vec;
-    for (const auto &v: vec) {
-        shared_vec.push_back(std::make_shared<Value>(v));
+static void countString(const SharedString &str) {
+    count(Counter::STRINGS);
+    count(Counter::STRING_BYTES, std::get<std::string>(str.base).size());
+}
+
+
+static void countList(const ValueList &list) {
+    size_t element = list.boxed() ? sizeof(Value) : list.bools() ? 0 : sizeof(long);
+    count(Counter::LISTS);
+    count(Counter::LIST_BYTES, element ? list.size() * element : list.size() / 8);
+}
+
+
+static void countDict(const ValueDict &dict) {
+    count(Counter::DICTS);
+    count(Counter::DICT_BYTES, dict.size() * sizeof(ValueDict::Entry));
+}
+
+
+Value::Value(const ValueBase &v) {
+    if (std::holds_alternative<std::string>(v)) {
+        auto str = makePayload<SharedString>(PayloadKind::STRING, v);
+        countString(*str);
+        data = std::move(str);
+    } else {
+        data = v;
+    }
+}
+
+
+Value::Value(ValueBase &&v) {
+    if (std::holds_alternative<std::string>(v)) {
+        auto str = makePayload<SharedString>(PayloadKind::STRING, std::move(v));
+        countString(*str);
+        data = std::move(str);
+    } else {
+        data = std::move(v);
+    }
+}
+
+
+Value::Value(const ValueList &v) : data(makePayload<ValueList>(PayloadKind::LIST, v)) {
+    countList(v);
+}
+
+
+Value::Value(ValueList &&v) : data(makePayload<ValueList>(PayloadKind::LIST, std::move(v))) {
+    countList(asList());
+}
+
+
+Value::Value(const ValueDict &v) : data(makePayload<ValueDict>(PayloadKind::DICT, v)) {
+    countDict(v);
+}
+
+
+Value::Value(ValueDict &&v) : data(makePayload<ValueDict>(PayloadKind::DICT, std::move(v))) {
+    countDict(asDict());
+}
+
+
+const void *Value::payload() const {
+    if (auto str = std::get_if<std::shared_ptr<SharedString>>(&data)) return str->get();
+    if (auto list = std::get_if<std::shared_ptr<ValueList>>(&data)) return list->get();
+    if (auto dict = std::get_if<std::shared_ptr<ValueDict>>(&data)) return dict->get();
+    return nullptr;
+}
+
+
+void Value::detach() {
+    if (auto str = std::get_if<std::shared_ptr<SharedString>>(&data)) {
+        if (str->use_count() > 1) {
+            *str = makePayload<SharedString>(PayloadKind::STRING, **str);
+            count(Counter::COPIES);
+            countString(**str);
+        }
+    } else if (auto list = std::get_if<std::shared_ptr<ValueList>>(&data)) {
+        if (list->use_count() > 1) {
+            *list = makePayload<ValueList>(PayloadKind::LIST, **list);
+            count(Counter::COPIES);
+            countList(**list);
+        }
+    } else if (auto dict = std::get_if<std::shared_ptr<ValueDict>>(&data)) {
+        if (dict->use_count() > 1) {
+            *dict = makePayload<ValueDict>(PayloadKind::DICT, **dict);
+            count(Counter::COPIES);
+            countDict(**dict);
+        }
+    }
+}
+
+
+void Value::recharge() {
+    if (auto str = std::get_if<std::shared_ptr<SharedString>>(&data)) {
+        (*str)->recharge();
+    }
+}
+
+
+// lists
+
+template<typename T>
+static bool holds(const Value &value) {
+    return value.isBase() && std::holds_alternative<T>(value.asBase());
+}
+
+
+size_t ValueList::size() const {
+    return std::visit([](const auto &vec) { return vec.size(); }, elements);
+}
+
+
+size_t ValueList::capacity() const {
+    return std::visit([](const auto &vec) { return vec.capacity(); }, elements);
+}
+
+
+void ValueList::reserve(size_t n) {
+    std::visit([n](auto &vec) { vec.reserve(n); }, elements);
+}
+
+
+bool ValueList::fits(const Value &value) const {
+    switch (elements.index()) {
+        case 1: return holds<long>(value);
+        case 2: return holds<double>(value);
+        case 3: return holds<bool>(value);
+        default: return true;
+    }
+}
+
+
+void ValueList::adopt(const Value &first) {
+    size_t reserved = capacity();
+    if (holds<long>(first)) {
+        elements = Storage<long>();
+    } else if (holds<double>(first)) {
+        elements = Storage<double>();
+    } else if (holds<bool>(first)) {
+        elements = Storage<bool>();
+    } else {
+        elements = Storage<Value>();
+    }
+    reserve(reserved);
+}
+
+
+void ValueList::box() {
+    if (boxed()) {
+        return;
+    }
+    Storage<Value> values;
+    values.reserve(capacity());
+    for (size_t i = 0; i < size(); ++i) {
+        values.push_back(get(i));
+    }
+    elements = std::move(values);
+}
+
+
+Value ValueList::get(size_t index) const {
+    return std::visit([index](const auto &vec) {
+        using T = typename std::decay_t<decltype(vec)>::value_type;
+        if constexpr (std::is_same_v<T, Value>) {
+            return vec[index];
+        } else {
+            return Value(static_cast<T>(vec[index]));
+        }
+    }, elements);
+}
+
+
+Value *ValueList::getRef(size_t index) {
+    if (auto values = std::get_if<Storage<Value>>(&elements)) {
+        return &(*values)[index];
+    }
+    return nullptr;
+}
+
+
+void ValueList::set(size_t index, const Value &value) {
+    if (!fits(value)) {
+        box();
+    }
+    std::visit([index, &value](auto &vec) {
+        using T = typename std::decay_t<decltype(vec)>::value_type;
+        if constexpr (std::is_same_v<T, Value>) {
+            vec[index] = value;
+        } else {
+            vec[index] = std::get<T>(value.asBase());
+        }
+    }, elements);
+}
+
+
+void ValueList::push_back(const Value &value) {
+    insert(size(), value);
+}
+
+
+void ValueList::insert(size_t index, const Value &value) {
+    if (empty()) {
+        adopt(value);
+    } else if (!fits(value)) {
+        box();
     }
-    data = std::move(shared_vec);
+    std::visit([index, &value](auto &vec) {
+        using T = typename std::decay_t<decltype(vec)>::value_type;
+        if constexpr (std::is_same_v<T, Value>) {
+            vec.insert(vec.begin() + index, value);
+        } else {
+            vec.insert(vec.begin() + index, std::get<T>(value.asBase()));
+        }
+    }, elements);
+}
+
+
+void ValueList::erase(size_t index) {
+    std::visit([index](auto &vec) { vec.erase(vec.begin() + index); }, elements);
 }
 
 
@@ -19,7 +236,7 @@ void Value::updateListElement(size_t index, const Value &value) {
     if (index >= asList().size()) {
         throw IndexError("Cannot update: index (" + std::to_string(index) + ") out of range");
     }
-    *asList()[index] = value;
+    asList().set(index, value);
 }
 
 
@@ -27,7 +244,236 @@ void Value::setDictElement(const ValueBase &key, const Value &value) {
     if (!isDict()) {
         throw TypeError("Cannot set/update element: not a dictionary");
     }
-    asDict()[key] = std::make_shared<Value>(value);
+    asDict()[key] = value;
+}
+
+
+// dictionaries
+
+// std::hash of an int is the int itself, so the multiplication mixes every bit of it into the slot index
+size_t ValueDict::slotFor(size_t hash) const {
+    return (hash * 0x9E3779B97F4A7C15ull) >> (64 - __builtin_ctzll(slots.size()));
+}
+
+
+size_t ValueDict::lookup(const ValueBase &key, size_t hash) const {
+    if (slots.empty()) {
+        return 0;
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t i = slotFor(hash);; i = (i + 1) & mask) {
+        uint32_t slot = slots[i];
+        if (slot == EMPTY) {
+            return slots.size();
+        }
+        if (slot != DELETED && entries[slot].hash == hash && entries[slot].key == key) {
+            return i;
+        }
+    }
+}
+
+
+void ValueDict::rebuild(size_t capacity) {
+    if (count != entries.size()) {
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry &e) { return e.erased; }),
+                      entries.end());
+    }
+    size_t size = 8;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots.assign(size, EMPTY);
+    size_t mask = size - 1;
+    for (uint32_t pos = 0; pos < entries.size(); ++pos) {
+        size_t i = slotFor(entries[pos].hash);
+        while (slots[i] != EMPTY) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = pos;
+    }
+    usedSlots = count;
+}
+
+
+void ValueDict::reserve(size_t n) {
+    if (n * 4 > slots.size() * 3) {
+        rebuild(n * 2);
+    }
+    entries.reserve(n);
+}
+
+
+const Value *ValueDict::find(const ValueBase &key) const {
+    size_t found = lookup(key, std::hash<ValueBase>()(key));
+    return found == slots.size() ? nullptr : &entries[slots[found]].value;
+}
+
+
+Value *ValueDict::find(const ValueBase &key) {
+    return const_cast<Value *>(std::as_const(*this).find(key));
+}
+
+
+Value &ValueDict::operator[](const ValueBase &key) {
+    size_t hash = std::hash<ValueBase>()(key);
+    size_t found = lookup(key, hash);
+    if (found != slots.size()) {
+        return entries[slots[found]].value;
+    }
+    // deleted slots still lengthen probes, so they count towards the load
+    if ((usedSlots + 1) * 4 > slots.size() * 3) {
+        rebuild((count + 1) * 2);
+    }
+    size_t mask = slots.size() - 1, i = slotFor(hash);
+    while (slots[i] != EMPTY && slots[i] != DELETED) {
+        i = (i + 1) & mask;
+    }
+    if (slots[i] == EMPTY) {
+        ++usedSlots;
+    }
+    slots[i] = entries.size();
+    entries.push_back({hash, key, Value(), false});
+    ++count;
+    return entries.back().value;
+}
+
+
+bool ValueDict::erase(const ValueBase &key) {
+    size_t found = lookup(key, std::hash<ValueBase>()(key));
+    if (found == slots.size()) {
+        return false;
+    }
+    Entry &entry = entries[slots[found]];
+    entry.erased = true;
+    entry.key = ValueBase();
+    entry.value = Value();
+    slots[found] = DELETED;
+    --count;
+    // keep iteration dense once most of the array is gaps
+    if (entries.size() >= 32 && count < entries.size() / 4) {
+        rebuild(count * 2);
+    }
+    return true;
+}
+
+
+// iteration
+
+class ListIterator : public ValueIterator {
+private:
+    const Value list;
+    size_t index = 0;
+
+public:
+    explicit ListIterator(const Value &list) : list(list) {}
+
+    bool next(Value &element, Value *) override {
+        const ValueList &elements = list.asList();
+        if (index >= elements.size()) {
+            return false;
+        }
+        element = elements.get(index++);
+        return true;
+    }
+
+    void traverse(Tracer &tracer) const override {
+        tracer.visit(list);
+    }
+};
+
+
+class StringIterator : public ValueIterator {
+private:
+    const Value str;
+    size_t offset = 0;
+
+public:
+    explicit StringIterator(const Value &str) : str(str) {}
+
+    bool next(Value &element, Value *) override {
+        const std::string &s = std::get<std::string>(str.asBase());
+        if (offset >= s.size()) {
+            return false;
+        }
+        size_t width = utf8CharWidth(s[offset]);
+        element = Value(s.substr(offset, width));
+        offset += width;
+        return true;
+    }
+};
+
+
+class DictIterator : public ValueIterator {
+private:
+    const Value dict;
+    ValueDict::Iterator at, end;
+
+public:
+    explicit DictIterator(const Value &dict)
+            : dict(dict), at(this->dict.asDict().begin()), end(this->dict.asDict().end()) {}
+
+    bool next(Value &element, Value *second) override {
+        if (!(at != end)) {
+            return false;
+        }
+        element = Value(at->key);
+        if (second) {
+            *second = at->value;
+        }
+        ++at;
+        return true;
+    }
+
+    void traverse(Tracer &tracer) const override {
+        tracer.visit(dict);
+    }
+};
+
+
+// lets a loop walk an iterator value without owning it, so the loop and other copies share its position
+class SharedIterator : public ValueIterator {
+private:
+    std::shared_ptr<ValueIterator> iterator;
+
+public:
+    explicit SharedIterator(std::shared_ptr<ValueIterator> iterator) : iterator(std::move(iterator)) {}
+
+    bool next(Value &element, Value *second) override {
+        return iterator->next(element, second);
+    }
+
+    void traverse(Tracer &tracer) const override {
+        tracer.visit(iterator);
+    }
+};
+
+
+std::unique_ptr<ValueIterator> makeIterator(const Value &iterable, bool pairs) {
+    if (iterable.isIterator() && !pairs) {
+        return std::make_unique<SharedIterator>(iterable.asIterator());
+    } else if (iterable.isDict()) {
+        return std::make_unique<DictIterator>(iterable);
+    } else if (pairs) {
+        throw TypeError("Cannot iterate over key-value pairs: not a dictionary");
+    } else if (iterable.isList()) {
+        return std::make_unique<ListIterator>(iterable);
+    } else if (iterable.isBase() && std::holds_alternative<std::string>(iterable.asBase())) {
+        return std::make_unique<StringIterator>(iterable);
+    }
+    throw TypeError("Cannot iterate: not a list, dictionary or string");
+}
+
+
+void Value::trace(Tracer &tracer) const {
+    if (auto list = std::get_if<std::shared_ptr<ValueList>>(&data)) {
+        tracer.visit(*list);
+    } else if (auto dict = std::get_if<std::shared_ptr<ValueDict>>(&data)) {
+        tracer.visit(*dict);
+    } else if (auto iterator = std::get_if<std::shared_ptr<ValueIterator>>(&data)) {
+        tracer.visit(*iterator);
+    } else if (auto closure = std::get_if<std::shared_ptr<const Closure>>(&data)) {
+        tracer.visit(*closure);
+    }
 }
 
 
@@ -36,8 +482,9 @@ std::vector<ValueBase> Value::getDictKeys() const {
         throw TypeError("Cannot get keys: not a dictionary");
     }
     std::vector<ValueBase> keys;
-    for (const auto &pair: asDict()) {
-        keys.push_back(pair.first);
+    keys.reserve(asDict().size());
+    for (const auto &entry: asDict()) {
+        keys.push_back(entry.key);
     }
     return keys;
 }
@@ -59,8 +506,16 @@ std::string toString(const ValueBase &v) {
 void printList(const ValueList &list, bool quotes) {
     std::cout << "[";
     for (size_t i = 0; i < list.size(); ++i) {
-        printValue(*list[i], quotes);
-        if (i < list.size() - 1) std::cout << ", ";
+        if (i > 0) std::cout << ", ";
+        if (auto ints = list.ints()) {
+            std::cout << (*ints)[i];
+        } else if (auto floats = list.floats()) {
+            std::cout << std::to_string((*floats)[i]);
+        } else if (auto bools = list.bools()) {
+            std::cout << ((*bools)[i] ? "true" : "false");
+        } else {
+            printValue((*list.boxed())[i], quotes);
+        }
     }
     std::cout << "]";
 }
@@ -69,11 +524,11 @@ void printList(const ValueList &list, bool quotes) {
 void printDict(const ValueDict &dict, bool quotes) {
     std::cout << "{";
     bool first = true;
-    for (const auto &[key, value]: dict) {
+    for (const auto &entry: dict) {
         if (!first) std::cout << ", ";
-        printValueBase(key, quotes);
+        printValueBase(entry.key, quotes);
         std::cout << ": ";
-        printValue(*value, quotes);
+        printValue(entry.value, quotes);
         first = false;
     }
     std::cout << "}";
@@ -90,6 +545,14 @@ void printValueBase(const ValueBase &v, bool quotes) {
 
 
 void printValue(const Value &value, bool quotes) {
+    if (value.isIterator()) {
+        std::cout << "<iterator>";
+        return;
+    }
+    if (value.isFunction()) {
+        std::cout << "<function " << value.asFunction()->name << ">";
+        return;
+    }
     value.visit([&quotes](const auto &v) {
         using T = std::decay_t<decltype(v)>;
         if constexpr (std::is_same_v<T, std::monostate>) {
@@ -3,28 +3,136 @@
 
 #include <variant>
 #include <vector>
-#include <unordered_map>
+#include <cstdint>
 #include <memory>
+#include "../util/counters.h"
+#include "../util/quota.h"
+#include "../util/utf8string.h"
 
 
 class Value;
+class ValueDict;
+class ValueIterator;
+struct Closure;
+class FunctionDeclarationNode;
+class Tracer;
 using ValueBase = std::variant<long, double, std::string, bool>;
-using ValueList = std::vector<std::shared_ptr<Value>>;
-using ValueDict = std::unordered_map<ValueBase, std::shared_ptr<Value>>;
+
+
+// the storage of lists and dictionaries, charged to the run's memory quota
+template<typename T>
+using Storage = std::vector<T, QuotaAllocator<T>>;
+
+// lists holding only ints, only floats or only bools keep their elements unboxed;
+// the first element of any other type converts the list to boxed Values for good
+class ValueList {
+private:
+    std::variant<Storage<Value>, Storage<long>, Storage<double>, Storage<bool>> elements;
+
+    void adopt(const Value &first);
+
+    void box();
+
+    bool fits(const Value &value) const;
+
+public:
+    ValueList() = default;
+
+    explicit ValueList(Storage<long> ints) : elements(std::move(ints)) {}
+
+    explicit ValueList(Storage<double> floats) : elements(std::move(floats)) {}
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    size_t capacity() const;
+
+    void reserve(size_t n);
+
+    Value get(size_t index) const;
+
+    // unboxed elements are plain scalars with no storage to refer to, so this returns nullptr for them
+    Value *getRef(size_t index);
+
+    void set(size_t index, const Value &value);
+
+    void push_back(const Value &value);
+
+    void insert(size_t index, const Value &value);
+
+    void erase(size_t index);
+
+    const Storage<Value> *boxed() const { return std::get_if<Storage<Value>>(&elements); }
+    const Storage<long> *ints() const { return std::get_if<Storage<long>>(&elements); }
+    const Storage<double> *floats() const { return std::get_if<Storage<double>>(&elements); }
+    const Storage<bool> *bools() const { return std::get_if<Storage<bool>>(&elements); }
+
+    // for kernels that rearrange the elements in place
+    Storage<Value> *boxed() { return std::get_if<Storage<Value>>(&elements); }
+    Storage<long> *ints() { return std::get_if<Storage<long>>(&elements); }
+    Storage<double> *floats() { return std::get_if<Storage<double>>(&elements); }
+    Storage<bool> *bools() { return std::get_if<Storage<bool>>(&elements); }
+};
+
+// a string payload together with its character index, which is copied along with it. The text's heap block is charged
+// to the memory quota when the payload is made and again after every in-place edit, and released when it goes away
+struct SharedString {
+    ValueBase base;
+    Utf8Index index;
+    size_t charged = 0;
+
+    explicit SharedString(ValueBase base) : base(std::move(base)) { recharge(); }
+
+    SharedString(const SharedString &other) : base(other.base), index(other.index) { recharge(); }
+
+    SharedString &operator=(const SharedString &) = delete;
+
+    ~SharedString() { releaseQuota(charged); }
+
+    // charges or releases the change in the size of the text's heap block since it was last charged
+    void recharge() {
+        if (!quotaEnabled) {
+            return;
+        }
+        size_t capacity = std::get<std::string>(base).capacity();
+        // short strings live inside the string object
+        size_t block = capacity > 15 ? capacity + 1 : 0;
+        if (block > charged) {
+            chargeQuota(block - charged);
+        } else {
+            releaseQuota(charged - block);
+        }
+        charged = block;
+    }
+};
 
 class Value {
 private:
-    std::variant<std::monostate, ValueBase, ValueList, ValueDict> data = std::monostate();
+    // strings, lists and dictionaries are shared between copies and detached only on write.
+    // iterators are never detached: every copy consumes the same stream. Functions can't be changed at all
+    std::variant<std::monostate, ValueBase, std::shared_ptr<SharedString>, std::shared_ptr<ValueList>,
+            std::shared_ptr<ValueDict>, std::shared_ptr<ValueIterator>, std::shared_ptr<const Closure>> data;
+
+    void detach();
 
 public:
     Value() : data(std::monostate()) {}
-    explicit Value(const ValueBase& v) : data(v) {}
-    explicit Value(ValueBase&& v) : data(std::move(v)) {}
-    explicit Value(const ValueList& v) : data(v) {}
-    explicit Value(ValueList&& v) : data(std::move(v)) {}
-    explicit Value(const std::vector<Value>& vec);
-    explicit Value(const ValueDict& v) : data(v) {}
-    explicit Value(ValueDict&& v) : data(std::move(v)) {}
+    explicit Value(const ValueBase& v);
+    explicit Value(ValueBase&& v);
+    explicit Value(const ValueList& v);
+    explicit Value(ValueList&& v);
+    explicit Value(const ValueDict& v);
+    explicit Value(ValueDict&& v);
+    // iterators and functions. A template, so that literal zeroes like Value(0L) don't also match as null pointers
+    template<typename Payload>
+    explicit Value(std::shared_ptr<Payload> v) {
+        if constexpr (std::is_same_v<std::remove_const_t<Payload>, Closure>) {
+            count(Counter::FUNCTION_VALUES);
+            data = std::shared_ptr<const Closure>(std::move(v));
+        } else {
+            count(Counter::ITERATORS);
+            data = std::shared_ptr<ValueIterator>(std::move(v));
+        }
+    }
 
     Value(const Value& other) : data(other.data) {}
 
@@ -45,30 +153,152 @@ public:
     }
 
     bool isNull() const { return std::holds_alternative<std::monostate>(data); }
-    bool isBase() const { return std::holds_alternative<ValueBase>(data); }
-    bool isList() const { return std::holds_alternative<ValueList>(data); }
-    bool isDict() const { return std::holds_alternative<ValueDict>(data); }
+    bool isBase() const {
+        return std::holds_alternative<ValueBase>(data) || std::holds_alternative<std::shared_ptr<SharedString>>(data);
+    }
+    bool isList() const { return std::holds_alternative<std::shared_ptr<ValueList>>(data); }
+    bool isDict() const { return std::holds_alternative<std::shared_ptr<ValueDict>>(data); }
+    bool isIterator() const { return std::holds_alternative<std::shared_ptr<ValueIterator>>(data); }
+    bool isFunction() const { return std::holds_alternative<std::shared_ptr<const Closure>>(data); }
 
-    const ValueBase& asBase() const { return std::get<ValueBase>(data); }
-    const ValueList& asList() const { return std::get<ValueList>(data); }
-    const ValueDict& asDict() const { return std::get<ValueDict>(data); }
+    const ValueBase& asBase() const {
+        if (auto str = std::get_if<std::shared_ptr<SharedString>>(&data)) return (*str)->base;
+        return std::get<ValueBase>(data);
+    }
+    const ValueList& asList() const { return *std::get<std::shared_ptr<ValueList>>(data); }
+    const ValueDict& asDict() const { return *std::get<std::shared_ptr<ValueDict>>(data); }
+    const std::shared_ptr<ValueIterator>& asIterator() const { return std::get<std::shared_ptr<ValueIterator>>(data); }
+    const std::shared_ptr<const Closure>& asFunction() const { return std::get<std::shared_ptr<const Closure>>(data); }
 
-    ValueBase& asBase() { return std::get<ValueBase>(data); }
-    ValueList& asList() { return std::get<ValueList>(data); }
-    ValueDict& asDict() { return std::get<ValueDict>(data); }
+    // non-const accessors give up sharing first, so only this copy sees the mutation
+    ValueBase& asBase() {
+        detach();
+        if (auto str = std::get_if<std::shared_ptr<SharedString>>(&data)) {
+            (*str)->index.reset();
+            return (*str)->base;
+        }
+        return std::get<ValueBase>(data);
+    }
+    ValueList& asList() { detach(); return *std::get<std::shared_ptr<ValueList>>(data); }
+    ValueDict& asDict() { detach(); return *std::get<std::shared_ptr<ValueDict>>(data); }
+
+    // only valid for string values
+    const Utf8Index& strIndex() const { return std::get<std::shared_ptr<SharedString>>(data)->index; }
 
     template<typename Visitor>
     auto visit(Visitor&& visitor) const {
-        return std::visit(std::forward<Visitor>(visitor), data);
+        if (isList()) return visitor(asList());
+        if (isDict()) return visitor(asDict());
+        if (isBase()) return visitor(asBase());
+        return visitor(std::monostate());
     }
 
+    // settles the memory quota after a string was edited in place through asBase()
+    void recharge();
+
     void updateListElement(size_t index, const Value& value);
 
     void setDictElement(const ValueBase& key, const Value& value);
 
     std::vector<ValueBase> getDictKeys() const;
+
+    // the string, list or dictionary payload shared by this copy, or nullptr for other values
+    const void *payload() const;
+
+    // visits the payload shared by this copy, if it is one the cycle collector traces
+    void trace(Tracer &tracer) const;
+};
+
+// a function as a value. It holds copies of the variables its body uses that were visible where the value was made,
+// instead of that whole scope chain, and every call starts from these copies. The functions its body calls that were
+// visible there, its own name included, are held the same way
+struct Closure {
+    std::string name;
+    std::shared_ptr<FunctionDeclarationNode> function;
+    std::vector<std::pair<std::string, Value>> captures;
+    std::vector<std::pair<std::string, std::shared_ptr<FunctionDeclarationNode>>> functions;
 };
 
+// an insertion-ordered hash map: entries sit in a dense array in the order they were added, and an open-addressing
+// table of entry positions finds them by key. Entries keep their key's hash, so growing the table never rehashes keys.
+// erased entries leave a gap in the array until the next rebuild
+class ValueDict {
+public:
+    struct Entry {
+        size_t hash;
+        ValueBase key;
+        Value value;
+        bool erased;
+    };
+
+    class Iterator {
+    private:
+        const Entry *at, *end;
+
+        void skipErased() { while (at != end && at->erased) ++at; }
+
+    public:
+        Iterator(const Entry *at, const Entry *end) : at(at), end(end) { skipErased(); }
+
+        const Entry &operator*() const { return *at; }
+        const Entry *operator->() const { return at; }
+        Iterator &operator++() { ++at; skipErased(); return *this; }
+        bool operator!=(const Iterator &other) const { return at != other.at; }
+    };
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    static constexpr uint32_t DELETED = UINT32_MAX - 1;
+
+    Storage<Entry> entries;
+    // positions in entries, or EMPTY/DELETED
+    Storage<uint32_t> slots;
+    size_t count = 0;
+    size_t usedSlots = 0;
+
+    size_t slotFor(size_t hash) const;
+
+    // the slot holding the key, or slots.size() if it is absent
+    size_t lookup(const ValueBase &key, size_t hash) const;
+
+    void rebuild(size_t capacity);
+
+public:
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void reserve(size_t n);
+
+    const Value *find(const ValueBase &key) const;
+    Value *find(const ValueBase &key);
+
+    // inserts a null value if the key is absent
+    Value &operator[](const ValueBase &key);
+
+    bool erase(const ValueBase &key);
+
+    Iterator begin() const { return {entries.data(), entries.data() + entries.size()}; }
+    Iterator end() const { return {entries.data() + entries.size(), entries.data() + entries.size()}; }
+};
+
+// walks the elements of a list, the characters of a string or the keys of a dictionary, optionally with their values.
+// it keeps its own reference to the container instead of a copy, so a loop body that mutates the container makes
+// the container copy itself on write, and the iteration carries on over the contents it started with.
+// iterator values, such as generators, produce their elements on demand and can be walked only once
+class ValueIterator {
+public:
+    virtual ~ValueIterator() = default;
+
+    // false once there are no elements left; second is only filled in for dictionaries
+    virtual bool next(Value &element, Value *second) = 0;
+
+    // visits every scope and value this iterator keeps alive
+    virtual void traverse(Tracer &) const {}
+};
+
+// throws TypeError for values that can't be iterated, or can't be iterated in pairs
+std::unique_ptr<ValueIterator> makeIterator(const Value &iterable, bool pairs);
+
 std::string toString(const ValueBase &v);
 
 void printValueBase(const ValueBase& v, bool quotes);
@@ -1,30 +1,104 @@
+#include "util/counters.h"
 #include "util/errors.h"
+#include "util/fuel.h"
+#include "util/heatmap.h"
+#include "util/profiler.h"
+#include "util/quota.h"
+#include "util/trace.h"
+#include "core/heap.h"
 #include "core/main/parser.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <sstream>
 
 #define RST  "\x1B[0m"
 #define RED  "\x1B[31m"
 
 
-int main() {
-    std::cout << std::boolalpha << std::fixed;
+// every line read so far, for the heatmap
+static std::vector<std::string> source;
+
+
+static void addSource(const std::string &text) {
+    std::stringstream lines(text);
+    for (std::string line; std::getline(lines, line);) {
+        source.push_back(line);
+    }
+}
+
+
+// runs the statements, printing any error; false if there was one
+static bool report(const std::function<void()> &statements) {
+    try {
+        statements();
+        return true;
+    } catch (const ControlFlowException &e) {
+        std::cout << RED << "Control flow error: Use of " + std::string(e.what()) + " outside of a loop" << RST << std::endl;
+    } catch (const ReturnException &e) {
+        std::cout << RED << "Control flow error: Use of RETURN outside of a function" << RST << std::endl;
+    } catch (const BaseError &e) {
+        std::cout << RED << e.what() << RST << std::endl;
+    } catch (const std::exception &e) {
+        std::cout << RED << "Unexpected error: " << e.what() << RST << std::endl;
+    }
+    return false;
+}
+
+
+// runs a whole file without echoing results; false if it stopped on an error
+static bool runScript(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << RED << "Cannot open " << path << RST << std::endl;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    addSource(text.str());
+
+    Lexer lexer("");
+    Parser parser(lexer);
+    lexer.reset(text.str() + "\n");
+    auto globalScope = std::make_shared<Scope>();
+    StackFrame root(profileLabel(path));
+    armLimits();
+    return report([&] {
+        parser.advanceToken();
+        for (const auto &statement: parser.parse()) {
+            setCurrentLine(statement->getLine());
+            TraceSpan span(TraceSpan::Kind::STATEMENT, 0);
+            LineProbe probe(*statement);
+            statement->evaluate(globalScope);
+        }
+    });
+}
+
+
+static void runRepl() {
     Lexer lexer("");
     Parser parser(lexer);
     auto globalScope = std::make_shared<Scope>();
     std::string input;
-    bool continuation;
+    bool continuation, quit = false;
+    StackFrame root(profileLabel("<repl>"));
 
     std::cout << "Type 'exit' to quit" << std::endl;
-    while (true) {
+    while (!quit) {
         std::cout << "> ";
         std::string line;
         input.clear();
-        try {
+        report([&] {
             do {
-                std::getline(std::cin, line);
+                if (!std::getline(std::cin, line)) {
+                    line = "exit";
+                }
                 line.erase(line.find_last_not_of(" \t") + 1);
                 if (line == "exit" && input.empty()) {
-                    return 0;
+                    quit = true;
+                    return;
                 }
                 if (!line.empty() && line.back() == '\\') {
                     line.pop_back();
@@ -39,22 +113,95 @@ int main() {
                 lexer.reset(input);
                 parser.advanceToken();
             } while (continuation || !parser.isStatementComplete());
+            // lines are numbered across the whole session
+            lexer.firstLine += std::count(input.begin(), input.end(), '\n');
+            addSource(input);
 
             auto statements = parser.parse();
-            Value result;
+            // every input gets the whole budget
+            armLimits();
             for (const auto &statement: statements) {
-                result = statement->evaluate(globalScope);
+                setCurrentLine(statement->getLine());
+                Value result;
+                {
+                    TraceSpan span(TraceSpan::Kind::STATEMENT, 0);
+                    LineProbe probe(*statement);
+                    result = statement->evaluate(globalScope);
+                }
                 printValue(result, true);
                 std::cout << std::endl;
             }
-        } catch (const ControlFlowException &e) {
-            std::cout << RED << "Control flow error: Use of " + std::string(e.what()) + " outside of a loop" << RST << std::endl;
-        } catch (const ReturnException &e) {
-            std::cout << RED << "Control flow error: Use of RETURN outside of a function" << RST << std::endl;
-        } catch (const BaseError &e) {
-            std::cout << RED << e.what() << RST << std::endl;
-        } catch (const std::exception &e) {
-            std::cout << RED << "Unexpected error: " << e.what() << RST << std::endl;
+        });
+    }
+}
+
+
+int main(int argc, char **argv) {
+    std::cout << std::boolalpha << std::fixed;
+    std::string profile, heatmap, trace, script;
+    long traceThreshold = 0, fuel = 0, timeout = 0;
+    bool printStats = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) {
+            profile = "profile.folded";
+        } else if (std::strncmp(argv[i], "--profile=", 10) == 0) {
+            profile = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--fuel=", 7) == 0) {
+            fuel = std::strtol(argv[i] + 7, nullptr, 10);
+        } else if (std::strncmp(argv[i], "--timeout=", 10) == 0) {
+            timeout = std::strtol(argv[i] + 10, nullptr, 10);
+        } else if (std::strncmp(argv[i], "--memory-limit=", 15) == 0) {
+            setMemoryLimit(std::strtoul(argv[i] + 15, nullptr, 10));
+        } else if (std::strcmp(argv[i], "--heatmap") == 0) {
+            heatmap = "heatmap.json";
+        } else if (std::strncmp(argv[i], "--heatmap=", 10) == 0) {
+            heatmap = argv[i] + 10;
+        } else if (std::strcmp(argv[i], "--heap-profile") == 0) {
+            startHeapProfile();
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            printStats = true;
+        } else if (std::strcmp(argv[i], "--trace") == 0) {
+            trace = "trace.json";
+        } else if (std::strncmp(argv[i], "--trace=", 8) == 0) {
+            trace = argv[i] + 8;
+        } else if (std::strncmp(argv[i], "--trace-threshold=", 18) == 0) {
+            traceThreshold = std::strtol(argv[i] + 18, nullptr, 10);
+        } else if (script.empty() && argv[i][0] != '-') {
+            script = argv[i];
+        } else {
+            std::cout << "Usage: " << argv[0] << " [--profile[=file]] [--heatmap[=file]] [--trace[=file]]\n"
+                      << "    [--trace-threshold=microseconds] [--stats] [--heap-profile] [--fuel=units]\n"
+                      << "    [--timeout=milliseconds] [--memory-limit=bytes] [script]" << std::endl;
+            return 2;
         }
     }
+
+    registerCounters();
+    setLimits(std::max(fuel, 0L), std::chrono::milliseconds(std::max(timeout, 0L)));
+    if (!profile.empty() && !startProfiler(profile)) {
+        std::cout << RED << "Cannot start the profiler" << RST << std::endl;
+        return 1;
+    }
+    if (!heatmap.empty()) {
+        startHeatmap(heatmap);
+    }
+    if (!trace.empty()) {
+        startTrace(trace, std::chrono::microseconds(traceThreshold));
+    }
+    bool succeeded = true;
+    if (script.empty()) {
+        runRepl();
+    } else {
+        succeeded = runScript(script);
+    }
+    if (!profile.empty()) {
+        stopProfiler();
+    }
+    stopHeatmap(source);
+    stopTrace();
+    if (printStats) {
+        printCounters();
+    }
+    printMemoryUsage();
+    return succeeded ? 0 : 1;
 }
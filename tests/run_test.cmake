@@ -0,0 +1,42 @@
+# runs one test script and compares what it prints to stdout, without colours, with the expected output.
+# arguments for the interpreter can go in a .args file next to the script. Next to it as well, optionally:
+# - a .err file with the expected stderr, which is otherwise not compared
+# - a .files file naming the files the run writes, one per line. Each is compared as if it had been printed after the
+#   output, under a "== <file> ==" line, and removed afterwards
+# - a .masks file with regular expressions, one per line. Whatever they match, in the output, stderr and files, is
+#   replaced by "#" first, for the timings and other numbers that change from run to run
+set(arguments "")
+if(EXISTS ${ARGUMENTS})
+    file(READ ${ARGUMENTS} arguments)
+    string(STRIP "${arguments}" arguments)
+    separate_arguments(arguments)
+endif()
+execute_process(COMMAND ${INTERPRETER} ${arguments} ${SCRIPT} OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+if(EXISTS ${FILES})
+    file(STRINGS ${FILES} written)
+    foreach(name ${written})
+        file(READ ${name} contents)
+        file(REMOVE ${name})
+        string(APPEND output "== ${name} ==\n${contents}")
+    endforeach()
+endif()
+string(ASCII 27 escape)
+string(REGEX REPLACE "${escape}\\[[0-9;]*m" "" output "${output}")
+string(REGEX REPLACE "${escape}\\[[0-9;]*m" "" errors "${errors}")
+if(EXISTS ${MASKS})
+    file(STRINGS ${MASKS} masks)
+    foreach(mask ${masks})
+        string(REGEX REPLACE "${mask}" "#" output "${output}")
+        string(REGEX REPLACE "${mask}" "#" errors "${errors}")
+    endforeach()
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "Expected:\n${expected}\nGot:\n${output}\n${errors}")
+endif()
+if(EXISTS ${EXPECTED_ERRORS})
+    file(READ ${EXPECTED_ERRORS} expected)
+    if(NOT errors STREQUAL expected)
+        message(FATAL_ERROR "Expected on stderr:\n${expected}\nGot:\n${errors}")
+    endif()
+endif()
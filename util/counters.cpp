@@ -0,0 +1,85 @@
+#include "counters.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+
+thread_local constinit ThreadCounters threadCounters{};
+
+static const char *counterNames[] = {
+        "scopes", "strings", "lists", "dicts", "iterators", "function_values", "copies", "string_bytes", "list_bytes",
+        "dict_bytes", "function_calls", "builtin_calls", "control_flow_exceptions",
+};
+
+static const char *nodeNames[] = {
+        "float", "int", "string", "bool", "type_cast", "unary_op", "binary_op", "assignment", "variable", "list", "dict",
+        "index_access", "index_assignment", "method_call", "block", "if_else", "for_loop", "while_loop", "control_flow",
+        "return", "yield", "function_declaration", "function_call",
+};
+
+static_assert(std::size(counterNames) == static_cast<size_t>(Counter::COUNT));
+static_assert(std::size(nodeNames) == static_cast<size_t>(NodeKind::COUNT));
+
+static std::mutex mutex;
+static std::vector<ThreadCounters *> registered;
+// what threads that exited counted
+static uint64_t retiredCounters[std::size(counterNames)], retiredNodes[std::size(nodeNames)];
+
+
+void registerCounters() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(registered.begin(), registered.end(), &threadCounters) == registered.end()) {
+        registered.push_back(&threadCounters);
+    }
+}
+
+
+void unregisterCounters() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find(registered.begin(), registered.end(), &threadCounters);
+    if (it == registered.end()) {
+        return;
+    }
+    registered.erase(it);
+    for (size_t i = 0; i < std::size(counterNames); ++i) {
+        retiredCounters[i] += threadCounters.counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < std::size(nodeNames); ++i) {
+        retiredNodes[i] += threadCounters.nodes[i].load(std::memory_order_relaxed);
+    }
+}
+
+
+std::vector<std::pair<std::string, uint64_t>> collectCounters() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::pair<std::string, uint64_t>> totals;
+    for (size_t i = 0; i < std::size(counterNames); ++i) {
+        uint64_t total = retiredCounters[i];
+        for (ThreadCounters *counters: registered) {
+            total += counters->counters[i].load(std::memory_order_relaxed);
+        }
+        totals.emplace_back(counterNames[i], total);
+    }
+    for (size_t i = 0; i < std::size(nodeNames); ++i) {
+        uint64_t total = retiredNodes[i];
+        for (ThreadCounters *counters: registered) {
+            total += counters->nodes[i].load(std::memory_order_relaxed);
+        }
+        totals.emplace_back(nodeNames[i], total);
+    }
+    return totals;
+}
+
+
+void printCounters() {
+    auto totals = collectCounters();
+    std::cerr << "Interpreter counters:\n";
+    for (size_t i = 0; i < totals.size(); ++i) {
+        if (i == std::size(counterNames)) {
+            std::cerr << "Nodes evaluated:\n";
+        }
+        std::cerr << std::setw(16) << totals[i].second << "  " << totals[i].first << '\n';
+    }
+    std::cerr << std::flush;
+}
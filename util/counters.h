@@ -0,0 +1,90 @@
+#ifndef CPP_INTERPRETER_COUNTERS_H
+#define CPP_INTERPRETER_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// what the interpreter counts as it runs. Payloads are counted when they are allocated, including the copies made when
+// a shared string, list or dictionary is written to; their bytes are the size of their contents at that moment
+enum class Counter {
+    SCOPES,
+    STRINGS,
+    LISTS,
+    DICTS,
+    ITERATORS,
+    FUNCTION_VALUES,
+    COPIES,
+    STRING_BYTES,
+    LIST_BYTES,
+    DICT_BYTES,
+    FUNCTION_CALLS,
+    BUILTIN_CALLS,
+    CONTROL_FLOW_EXCEPTIONS,
+    COUNT
+};
+
+// the AST nodes, for counting evaluations
+enum class NodeKind {
+    FLOAT,
+    INT,
+    STRING,
+    BOOL,
+    TYPE_CAST,
+    UNARY_OP,
+    BINARY_OP,
+    ASSIGNMENT,
+    VARIABLE,
+    LIST,
+    DICT,
+    INDEX_ACCESS,
+    INDEX_ASSIGNMENT,
+    METHOD_CALL,
+    BLOCK,
+    IF_ELSE,
+    FOR_LOOP,
+    WHILE_LOOP,
+    CONTROL_FLOW,
+    RETURN,
+    YIELD,
+    FUNCTION_DECLARATION,
+    FUNCTION_CALL,
+    COUNT
+};
+
+// every thread counts into its own set, which only that thread writes. They are atomic so that other threads can read
+// them while they change, but increments are plain loads and stores, not read-modify-write instructions
+struct ThreadCounters {
+    std::atomic<uint64_t> counters[static_cast<size_t>(Counter::COUNT)];
+    std::atomic<uint64_t> nodes[static_cast<size_t>(NodeKind::COUNT)];
+};
+
+extern thread_local constinit ThreadCounters threadCounters;
+
+inline void count(Counter counter, uint64_t amount = 1) {
+    auto &value = threadCounters.counters[static_cast<size_t>(counter)];
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void countNode(NodeKind kind) {
+    auto &value = threadCounters.nodes[static_cast<size_t>(kind)];
+    value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// adds the calling thread's counters to the totals. A thread that doesn't register still counts, but isn't reported
+void registerCounters();
+
+// keeps the calling thread's counts in the totals once it exits
+void unregisterCounters();
+
+// the totals over all threads, as name and value, counters first and then evaluations per node kind
+std::vector<std::pair<std::string, uint64_t>> collectCounters();
+
+// prints the totals to stderr
+void printCounters();
+
+
+#endif
@@ -66,6 +66,20 @@ public:
 };
 
 
+// a run went over its fuel budget or time limit
+class LimitError : public BaseError {
+public:
+    explicit LimitError(const std::string& message) : BaseError("Limit error: " + message) {}
+};
+
+
+// a run went over its memory limit
+class MemoryError : public BaseError {
+public:
+    explicit MemoryError(const std::string& message) : BaseError("Memory error: " + message) {}
+};
+
+
 // for break and continue
 class ControlFlowException : public BaseError {
 public:
@@ -0,0 +1,53 @@
+#include "fuel.h"
+#include "errors.h"
+#include "profiler.h"
+#include <atomic>
+#include <climits>
+
+
+using Clock = std::chrono::steady_clock;
+
+thread_local constinit long fuelLeft = 0;
+
+// how much fuel a thread takes at a time, which is also how often it looks at the clock
+static constexpr long SHARE = 1024;
+
+static long fuelLimit = 0;
+static std::chrono::milliseconds timeLimit{0};
+static std::atomic<long> budget{0};
+static Clock::time_point deadline;
+
+
+void setLimits(long fuel, std::chrono::milliseconds timeout) {
+    fuelLimit = fuel;
+    timeLimit = timeout;
+}
+
+
+void armLimits() {
+    budget.store(fuelLimit, std::memory_order_relaxed);
+    deadline = Clock::now() + timeLimit;
+    // whatever this thread had left belongs to the previous run. Workers can keep up to a share of theirs
+    fuelLeft = 0;
+}
+
+
+void refuel() {
+    if (timeLimit.count() && Clock::now() > deadline) {
+        fuelLeft = 0;
+        throw LimitError("Time limit of " + std::to_string(timeLimit.count()) + " ms exceeded at line " +
+                         std::to_string(currentLine()));
+    }
+    if (!fuelLimit) {
+        fuelLeft = timeLimit.count() ? SHARE : LONG_MAX;
+        return;
+    }
+    long available = budget.fetch_sub(SHARE, std::memory_order_relaxed);
+    if (available <= 0) {
+        fuelLeft = 0;
+        throw LimitError("Fuel budget of " + std::to_string(fuelLimit) + " used up at line " +
+                         std::to_string(currentLine()));
+    }
+    // the unit being burned comes out of the new share
+    fuelLeft = std::min(available, SHARE) - 1;
+}
@@ -0,0 +1,27 @@
+#ifndef CPP_INTERPRETER_FUEL_H
+#define CPP_INTERPRETER_FUEL_H
+
+#include <chrono>
+
+
+// the units of fuel this thread can still burn before it takes more from the run's budget
+extern thread_local constinit long fuelLeft;
+
+// takes the thread's next share of the budget and checks the deadline. Throws LimitError if either has run out
+void refuel();
+
+// one unit of fuel, burned by every loop iteration and function call
+inline void burnFuel() {
+    if (--fuelLeft < 0) {
+        refuel();
+    }
+}
+
+// the budget and wall-clock time each run gets; zero means no limit. Takes effect at the next armLimits()
+void setLimits(long fuel, std::chrono::milliseconds timeout);
+
+// starts a run: refills the budget and starts the clock. Call it while no other thread is running script code
+void armLimits();
+
+
+#endif
@@ -1,14 +1,63 @@
 #include "../core/main/ast.h"
+#include "../core/collector.h"
+#include "../core/heap.h"
 #include "utf8string.h"
 #include "functions.h"
 #include "errors.h"
+#include "simd.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <ctime>
+#include <unordered_map>
 
 #define CYAN "\x1B[36m"
 #ifndef RST
 #define RST  "\x1B[0m"
 #endif
 
+const Builtin *getBuiltinFunction(const std::string &name) {
+    static const std::unordered_map<std::string, Builtin> builtins = {
+            {"print", {print, true}},
+            {"type", {type, true}},
+            {"roundf", {roundf, true}},
+            {"round", {roundi, true}},
+            {"floor", {floori, true}},
+            {"ceil", {ceili, true}},
+            {"sum", {listsum, false}},
+            {"min", {listmin, false}},
+            {"max", {listmax, false}},
+            {"mean", {listmean, false}},
+            {"dot", {listdot, false}},
+            {"add", {listadd, false}},
+            {"mul", {listmul, false}},
+            {"scale", {listscale, false}},
+            {"abs", {listabs, false}},
+            {"sqrt", {listsqrt, false}},
+            {"range", {seqrange, false}},
+            {"map", {seqmap, false}},
+            {"filter", {seqfilter, false}},
+            {"take", {seqtake, false}},
+            {"zip", {seqzip, false}},
+            {"reduce", {seqreduce, false}},
+            {"list", {seqlist, false}},
+            {"sorted", {listsorted, false}},
+            {"psort", {listpsort, false}},
+            {"pmap", {parmap, false}},
+            {"preduce", {parreduce, false}},
+            {"gc", {gccollect, false}},
+            {"gcstats", {gcstats, false}},
+            {"stats", {runstats, false}},
+            {"heapdump", {heapdump, false}},
+            {"clock", {timeclock, false}},
+            {"cputime", {timecpu, false}},
+            {"bench", {timebench, false}},
+    };
+    auto it = builtins.find(name);
+    return it != builtins.end() ? &it->second : nullptr;
+}
+
 // functions
 
 Value print(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
@@ -30,9 +79,9 @@ Value type(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_p
     if (arguments.size() != 1) {
         throw ValueError("Function type() expects exactly 1 argument, but got " + std::to_string(arguments.size()));
     }
-    Value val = arguments[0]->evaluate(scope);
+    const Value val = arguments[0]->evaluate(scope);
     if (val.isBase()) {
-        ValueBase base = val.asBase();
+        const ValueBase &base = val.asBase();
         if (std::holds_alternative<double>(base)) return Value("float");
         if (std::holds_alternative<long>(base)) return Value("int");
         if (std::holds_alternative<bool>(base)) return Value("bool");
@@ -41,6 +90,10 @@ Value type(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_p
         return Value("list");
     } else if (val.isDict()) {
         return Value("dict");
+    } else if (val.isIterator()) {
+        return Value("iterator");
+    } else if (val.isFunction()) {
+        return Value("function");
     }
     return Value("null");
 }
@@ -103,9 +156,818 @@ Value ceili(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_
     return Value(static_cast<long>(std::ceil(std::get<double>(val.asBase()))));
 }
 
+// numeric list functions
+
+static void expectArguments(const std::string &function, const std::vector<std::unique_ptr<ASTNode>> &arguments,
+                            size_t count) {
+    if (arguments.size() != count) {
+        throw ValueError("Function " + function + "() expects exactly " + std::to_string(count) +
+                         (count == 1 ? " argument" : " arguments") + ", but got " + std::to_string(arguments.size()));
+    }
+}
+
+
+// a boxed list whose elements all share one numeric type is packed into 'repacked' first
+static const ValueList &numericList(const Value &value, ValueList &repacked, const std::string &function) {
+    if (!value.isList()) {
+        throw TypeError("Function " + function + "() expects a list of numbers");
+    }
+    const ValueList &list = value.asList();
+    if (list.ints() || list.floats() || list.empty()) {
+        return list;
+    }
+    repacked.reserve(list.size());
+    for (size_t i = 0; i < list.size(); ++i) {
+        repacked.push_back(list.get(i));
+    }
+    if (repacked.ints() || repacked.floats()) {
+        return repacked;
+    }
+    throw TypeError("Function " + function + "() expects a list of numbers");
+}
+
+
+static void expectMatching(const ValueList &xs, const ValueList &ys, const std::string &function) {
+    if (xs.size() != ys.size()) {
+        throw ValueError("Function " + function + "() expects lists of the same length");
+    }
+    if (!xs.empty() && (xs.ints() == nullptr) != (ys.ints() == nullptr)) {
+        throw TypeError("Function " + function + "() expects lists of the same number type");
+    }
+}
+
+
+Value listsum(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("sum", arguments, 1);
+    const Value listValue = arguments[0]->evaluate(scope);
+    ValueList repacked;
+    const ValueList &list = numericList(listValue, repacked, "sum");
+    if (auto ints = list.ints()) {
+        long result;
+        if (!sumInts(ints->data(), ints->size(), result)) {
+            throw ValueError("Integer overflow in sum()");
+        }
+        return Value(result);
+    } else if (auto floats = list.floats()) {
+        return Value(sumFloats(floats->data(), floats->size()));
+    }
+    return Value(0L);
+}
+
+
+static Value listextreme(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope,
+                         bool max) {
+    const std::string function = max ? "max" : "min";
+    expectArguments(function, arguments, 1);
+    const Value listValue = arguments[0]->evaluate(scope);
+    ValueList repacked;
+    const ValueList &list = numericList(listValue, repacked, function);
+    // a list emptied by remove() keeps its unboxed storage
+    if (list.empty()) {
+        throw ValueError("Function " + function + "() expects a non-empty list");
+    }
+    if (auto ints = list.ints()) {
+        return Value(max ? maxInts(ints->data(), ints->size()) : minInts(ints->data(), ints->size()));
+    } else if (auto floats = list.floats()) {
+        return Value(max ? maxFloats(floats->data(), floats->size()) : minFloats(floats->data(), floats->size()));
+    }
+    throw ValueError("Function " + function + "() expects a non-empty list");
+}
+
+
+Value listmin(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    return listextreme(arguments, scope, false);
+}
+
+
+Value listmax(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    return listextreme(arguments, scope, true);
+}
+
+
+Value listmean(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("mean", arguments, 1);
+    const Value listValue = arguments[0]->evaluate(scope);
+    ValueList repacked;
+    const ValueList &list = numericList(listValue, repacked, "mean");
+    if (list.empty()) {
+        throw ValueError("Function mean() expects a non-empty list");
+    }
+    if (auto ints = list.ints()) {
+        long total;
+        if (sumInts(ints->data(), ints->size(), total)) {
+            return Value(static_cast<double>(total) / static_cast<double>(ints->size()));
+        }
+        // the mean of ints always fits, even when their sum doesn't
+        long double wide = 0;
+        for (long x: *ints) {
+            wide += x;
+        }
+        return Value(static_cast<double>(wide / ints->size()));
+    } else if (auto floats = list.floats()) {
+        return Value(sumFloats(floats->data(), floats->size()) / static_cast<double>(floats->size()));
+    }
+    throw ValueError("Function mean() expects a non-empty list");
+}
+
+
+Value listdot(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("dot", arguments, 2);
+    const Value xsValue = arguments[0]->evaluate(scope);
+    const Value ysValue = arguments[1]->evaluate(scope);
+    ValueList xsRepacked, ysRepacked;
+    const ValueList &xs = numericList(xsValue, xsRepacked, "dot");
+    const ValueList &ys = numericList(ysValue, ysRepacked, "dot");
+    expectMatching(xs, ys, "dot");
+    if (auto ints = xs.ints()) {
+        long result;
+        if (!dotInts(ints->data(), ys.ints()->data(), ints->size(), result)) {
+            throw ValueError("Integer overflow in dot()");
+        }
+        return Value(result);
+    } else if (auto floats = xs.floats()) {
+        return Value(dotFloats(floats->data(), ys.floats()->data(), floats->size()));
+    }
+    return Value(0L);
+}
+
+
+static Value listelementwise(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope,
+                             const std::string &function,
+                             bool (*intKernel)(const long *, const long *, long *, size_t),
+                             void (*floatKernel)(const double *, const double *, double *, size_t)) {
+    expectArguments(function, arguments, 2);
+    const Value xsValue = arguments[0]->evaluate(scope);
+    const Value ysValue = arguments[1]->evaluate(scope);
+    ValueList xsRepacked, ysRepacked;
+    const ValueList &xs = numericList(xsValue, xsRepacked, function);
+    const ValueList &ys = numericList(ysValue, ysRepacked, function);
+    expectMatching(xs, ys, function);
+    if (auto ints = xs.ints()) {
+        Storage<long> result(ints->size());
+        if (!intKernel(ints->data(), ys.ints()->data(), result.data(), result.size())) {
+            throw ValueError("Integer overflow in " + function + "()");
+        }
+        return Value(ValueList(std::move(result)));
+    } else if (auto floats = xs.floats()) {
+        Storage<double> result(floats->size());
+        floatKernel(floats->data(), ys.floats()->data(), result.data(), result.size());
+        return Value(ValueList(std::move(result)));
+    }
+    return Value(ValueList());
+}
+
+
+Value listadd(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    return listelementwise(arguments, scope, "add", addInts, addFloats);
+}
+
+
+Value listmul(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    return listelementwise(arguments, scope, "mul", mulInts, mulFloats);
+}
+
+
+Value listscale(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("scale", arguments, 2);
+    const Value listValue = arguments[0]->evaluate(scope);
+    const Value factor = arguments[1]->evaluate(scope);
+    ValueList repacked;
+    const ValueList &list = numericList(listValue, repacked, "scale");
+    if (auto ints = list.ints()) {
+        if (!factor.isBase() || !std::holds_alternative<long>(factor.asBase())) {
+            throw TypeError("A list of ints can only be scaled by an int");
+        }
+        Storage<long> result(ints->size());
+        if (!scaleInts(ints->data(), std::get<long>(factor.asBase()), result.data(), result.size())) {
+            throw ValueError("Integer overflow in scale()");
+        }
+        return Value(ValueList(std::move(result)));
+    } else if (auto floats = list.floats()) {
+        if (!factor.isBase() || !std::holds_alternative<double>(factor.asBase())) {
+            throw TypeError("A list of floats can only be scaled by a float");
+        }
+        Storage<double> result(floats->size());
+        scaleFloats(floats->data(), std::get<double>(factor.asBase()), result.data(), result.size());
+        return Value(ValueList(std::move(result)));
+    }
+    return Value(ValueList());
+}
+
+
+Value listabs(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("abs", arguments, 1);
+    const Value listValue = arguments[0]->evaluate(scope);
+    ValueList repacked;
+    const ValueList &list = numericList(listValue, repacked, "abs");
+    if (auto ints = list.ints()) {
+        Storage<long> result(ints->size());
+        if (!absInts(ints->data(), result.data(), result.size())) {
+            throw ValueError("Integer overflow in abs()");
+        }
+        return Value(ValueList(std::move(result)));
+    } else if (auto floats = list.floats()) {
+        Storage<double> result(floats->size());
+        absFloats(floats->data(), result.data(), result.size());
+        return Value(ValueList(std::move(result)));
+    }
+    return Value(ValueList());
+}
+
+
+Value listsqrt(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("sqrt", arguments, 1);
+    const Value listValue = arguments[0]->evaluate(scope);
+    ValueList repacked;
+    const ValueList &list = numericList(listValue, repacked, "sqrt");
+    if (list.ints()) {
+        throw TypeError("Square root can only be taken of float types");
+    } else if (auto floats = list.floats()) {
+        Storage<double> result(floats->size());
+        sqrtFloats(floats->data(), result.data(), result.size());
+        return Value(ValueList(std::move(result)));
+    }
+    return Value(ValueList());
+}
+
+// lazy sequences
+// each of these pulls one element at a time from its source, so a chain of them runs as a single pass
+
+class RangeIterator : public ValueIterator {
+private:
+    long current, end, step;
+    bool done = false;
+
+public:
+    RangeIterator(long start, long end, long step) : current(start), end(end), step(step) {}
+
+    bool next(Value &element, Value *) override {
+        if (done) {
+            return false;
+        }
+        element = Value(current);
+        // compared as a remaining distance, so stepping never overflows past the end
+        __int128 remaining = step > 0 ? static_cast<__int128>(end) - current : static_cast<__int128>(current) - end;
+        if (remaining < (step > 0 ? static_cast<__int128>(step) : -static_cast<__int128>(step))) {
+            done = true;
+        } else {
+            current += step;
+        }
+        return true;
+    }
+};
+
+
+class MapIterator : public ValueIterator {
+private:
+    std::shared_ptr<const Closure> function;
+    std::unique_ptr<ValueIterator> source;
+    std::shared_ptr<Scope> scope;
+
+public:
+    MapIterator(std::shared_ptr<const Closure> function,
+                std::unique_ptr<ValueIterator> source, std::shared_ptr<Scope> scope)
+            : function(std::move(function)), source(std::move(source)), scope(std::move(scope)) {}
+
+    bool next(Value &element, Value *) override {
+        Value argument;
+        if (!source->next(argument, nullptr)) {
+            return false;
+        }
+        element = callFunction(*function, {std::move(argument)}, scope);
+        return true;
+    }
+
+    void traverse(Tracer &tracer) const override {
+        tracer.visit(function);
+        source->traverse(tracer);
+        tracer.visit(scope);
+    }
+};
+
+
+class FilterIterator : public ValueIterator {
+private:
+    std::shared_ptr<const Closure> function;
+    std::unique_ptr<ValueIterator> source;
+    std::shared_ptr<Scope> scope;
+
+public:
+    FilterIterator(std::shared_ptr<const Closure> function,
+                   std::unique_ptr<ValueIterator> source, std::shared_ptr<Scope> scope)
+            : function(std::move(function)), source(std::move(source)), scope(std::move(scope)) {}
+
+    bool next(Value &element, Value *) override {
+        while (source->next(element, nullptr)) {
+            const Value keep = callFunction(*function, {element}, scope);
+            if (!keep.isBase() || !std::holds_alternative<bool>(keep.asBase())) {
+                throw TypeError("Function filter() expects " + function->name + "() to return a boolean");
+            }
+            if (std::get<bool>(keep.asBase())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void traverse(Tracer &tracer) const override {
+        tracer.visit(function);
+        source->traverse(tracer);
+        tracer.visit(scope);
+    }
+};
+
+
+class TakeIterator : public ValueIterator {
+private:
+    std::unique_ptr<ValueIterator> source;
+    long remaining;
+
+public:
+    TakeIterator(std::unique_ptr<ValueIterator> source, long count) : source(std::move(source)), remaining(count) {}
+
+    bool next(Value &element, Value *) override {
+        if (remaining <= 0 || !source->next(element, nullptr)) {
+            return false;
+        }
+        --remaining;
+        return true;
+    }
+
+    void traverse(Tracer &tracer) const override {
+        source->traverse(tracer);
+    }
+};
+
+
+class ZipIterator : public ValueIterator {
+private:
+    std::unique_ptr<ValueIterator> first, second;
+
+public:
+    ZipIterator(std::unique_ptr<ValueIterator> first, std::unique_ptr<ValueIterator> second)
+            : first(std::move(first)), second(std::move(second)) {}
+
+    bool next(Value &element, Value *) override {
+        Value x, y;
+        if (!first->next(x, nullptr) || !second->next(y, nullptr)) {
+            return false;
+        }
+        ValueList pair;
+        pair.reserve(2);
+        pair.push_back(x);
+        pair.push_back(y);
+        element = Value(std::move(pair));
+        return true;
+    }
+
+    void traverse(Tracer &tracer) const override {
+        first->traverse(tracer);
+        second->traverse(tracer);
+    }
+};
+
+
+// a function's name on its own evaluates to a function value, so passing a function by name still works
+static std::shared_ptr<const Closure> functionArgument(const std::string &function,
+                                                       const std::unique_ptr<ASTNode> &argument,
+                                                       const std::shared_ptr<Scope> &scope) {
+    const Value value = argument->evaluate(scope);
+    if (!value.isFunction()) {
+        throw TypeError("Function " + function + "() expects a function as its first argument");
+    }
+    return value.asFunction();
+}
+
+
+static long intArgument(const std::string &function, const Value &value) {
+    if (!value.isBase() || !std::holds_alternative<long>(value.asBase())) {
+        throw TypeError("Function " + function + "() expects integer bounds and step");
+    }
+    return std::get<long>(value.asBase());
+}
+
+
+Value seqrange(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    if (arguments.size() != 2 && arguments.size() != 3) {
+        throw ValueError("Function range() expects 2 or 3 arguments, but got " + std::to_string(arguments.size()));
+    }
+    long start = intArgument("range", arguments[0]->evaluate(scope));
+    long end = intArgument("range", arguments[1]->evaluate(scope));
+    long step = (start <= end) ? 1 : -1;
+    if (arguments.size() == 3) {
+        step = intArgument("range", arguments[2]->evaluate(scope));
+        if (step == 0) {
+            throw ValueError("Range step cannot be zero");
+        }
+    }
+    if ((step > 0 && start > end) || (step < 0 && start < end)) {
+        throw ValueError("Invalid range and step combination");
+    }
+    return Value(std::make_shared<RangeIterator>(start, end, step));
+}
+
+
+Value seqmap(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("map", arguments, 2);
+    auto function = functionArgument("map", arguments[0], scope);
+    auto source = makeIterator(arguments[1]->evaluate(scope), false);
+    return Value(std::make_shared<MapIterator>(std::move(function), std::move(source), scope));
+}
+
+
+Value seqfilter(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("filter", arguments, 2);
+    auto function = functionArgument("filter", arguments[0], scope);
+    auto source = makeIterator(arguments[1]->evaluate(scope), false);
+    return Value(std::make_shared<FilterIterator>(std::move(function), std::move(source), scope));
+}
+
+
+Value seqtake(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("take", arguments, 2);
+    auto source = makeIterator(arguments[0]->evaluate(scope), false);
+    const Value count = arguments[1]->evaluate(scope);
+    if (!count.isBase() || !std::holds_alternative<long>(count.asBase())) {
+        throw TypeError("Function take() expects an integer count");
+    }
+    return Value(std::make_shared<TakeIterator>(std::move(source), std::get<long>(count.asBase())));
+}
+
+
+Value seqzip(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("zip", arguments, 2);
+    auto first = makeIterator(arguments[0]->evaluate(scope), false);
+    auto second = makeIterator(arguments[1]->evaluate(scope), false);
+    return Value(std::make_shared<ZipIterator>(std::move(first), std::move(second)));
+}
+
+
+Value seqreduce(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    if (arguments.size() != 2 && arguments.size() != 3) {
+        throw ValueError("Function reduce() expects 2 or 3 arguments, but got " + std::to_string(arguments.size()));
+    }
+    auto function = functionArgument("reduce", arguments[0], scope);
+    auto source = makeIterator(arguments[1]->evaluate(scope), false);
+    Value accumulator;
+    if (arguments.size() == 3) {
+        accumulator = arguments[2]->evaluate(scope);
+    } else if (!source->next(accumulator, nullptr)) {
+        throw ValueError("Function reduce() of an empty sequence expects an initial value");
+    }
+    Value element;
+    while (source->next(element, nullptr)) {
+        accumulator = callFunction(*function, {std::move(accumulator), element}, scope);
+    }
+    return accumulator;
+}
+
+
+Value seqlist(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("list", arguments, 1);
+    auto source = makeIterator(arguments[0]->evaluate(scope), false);
+    ValueList list;
+    Value element;
+    while (source->next(element, nullptr)) {
+        list.push_back(element);
+    }
+    return Value(std::move(list));
+}
+
+// sorting
+
+// NaN sorts after every number, which keeps the order a strict weak ordering
+static bool lessFloat(double a, double b) {
+    return a < b || (!std::isnan(a) && std::isnan(b));
+}
+
+
+// ints and floats are compared as long doubles, which hold every int exactly
+static bool lessNumber(const ValueBase &a, const ValueBase &b) {
+    if (std::holds_alternative<long>(a) && std::holds_alternative<long>(b)) {
+        return std::get<long>(a) < std::get<long>(b);
+    }
+    auto number = [](const ValueBase &v) -> long double {
+        return std::holds_alternative<long>(v) ? std::get<long>(v) : std::get<double>(v);
+    };
+    long double x = number(a), y = number(b);
+    return x < y || (!std::isnan(x) && std::isnan(y));
+}
+
+
+// sorts one chunk per thread, then merges neighbouring chunks pairwise until a single run is left
+template<typename T, typename Less>
+static void parallelSort(Storage<T> &xs, Less less) {
+    ThreadPool &pool = ThreadPool::instance();
+    size_t chunks = std::min(pool.size(), xs.size() / 8192);
+    if (chunks <= 1) {
+        std::sort(xs.begin(), xs.end(), less);
+        return;
+    }
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t i = 0; i <= chunks; ++i) {
+        bounds[i] = xs.size() * i / chunks;
+    }
+    pool.run(chunks, [&](size_t i) {
+        std::sort(xs.begin() + bounds[i], xs.begin() + bounds[i + 1], less);
+    });
+    for (size_t width = 1; width < chunks; width *= 2) {
+        pool.run((chunks + 2 * width - 1) / (2 * width), [&](size_t i) {
+            size_t low = 2 * width * i, middle = std::min(low + width, chunks), high = std::min(low + 2 * width, chunks);
+            if (middle < high) {
+                std::inplace_merge(xs.begin() + bounds[low], xs.begin() + bounds[middle], xs.begin() + bounds[high],
+                                   less);
+            }
+        });
+    }
+}
+
+
+template<typename T, typename Less>
+static void sortVector(Storage<T> &xs, Less less, bool parallel) {
+    if (parallel) {
+        parallelSort(xs, less);
+    } else {
+        std::sort(xs.begin(), xs.end(), less);
+    }
+}
+
+
+// unboxed lists are sorted as plain numbers; boxed ones must hold only numbers or only strings
+static void sortList(ValueList &list, bool parallel) {
+    if (auto ints = list.ints()) {
+        sortVector(*ints, std::less<long>(), parallel);
+    } else if (auto floats = list.floats()) {
+        sortVector(*floats, lessFloat, parallel);
+    } else if (auto bools = list.bools()) {
+        auto falses = std::count(bools->begin(), bools->end(), false);
+        std::fill(bools->begin(), bools->begin() + falses, false);
+        std::fill(bools->begin() + falses, bools->end(), true);
+    } else if (auto boxed = list.boxed()) {
+        bool strings = true, numbers = true;
+        for (const Value &element: *boxed) {
+            if (!element.isBase()) {
+                strings = numbers = false;
+                break;
+            }
+            const ValueBase &base = element.asBase();
+            strings = strings && std::holds_alternative<std::string>(base);
+            numbers = numbers && (std::holds_alternative<long>(base) || std::holds_alternative<double>(base));
+        }
+        if (strings) {
+            sortVector(*boxed, [](const Value &a, const Value &b) {
+                return std::get<std::string>(a.asBase()) < std::get<std::string>(b.asBase());
+            }, parallel);
+        } else if (numbers) {
+            sortVector(*boxed, [](const Value &a, const Value &b) {
+                return lessNumber(a.asBase(), b.asBase());
+            }, parallel);
+        } else {
+            throw TypeError("Only lists of numbers or lists of strings can be sorted");
+        }
+    }
+}
+
+
+static Value sortedCopy(const std::string &function, const std::vector<std::unique_ptr<ASTNode>> &arguments,
+                        std::shared_ptr<Scope> &scope, bool parallel) {
+    expectArguments(function, arguments, 1);
+    const Value listValue = arguments[0]->evaluate(scope);
+    if (!listValue.isList()) {
+        throw TypeError("Function " + function + "() expects a list");
+    }
+    ValueList list = listValue.asList();
+    sortList(list, parallel);
+    return Value(std::move(list));
+}
+
+
+Value listsorted(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    return sortedCopy("sorted", arguments, scope, false);
+}
+
+
+Value listpsort(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    return sortedCopy("psort", arguments, scope, true);
+}
+
+// parallel functions
+// every chunk of the input runs in its own isolated copy of the caller's scope, so the function can't change the
+// caller's variables, and results can't depend on which thread ran first
+
+static std::vector<Value> collectElements(const Value &sequence) {
+    auto iterator = makeIterator(sequence, false);
+    std::vector<Value> elements;
+    if (sequence.isList()) {
+        elements.reserve(sequence.asList().size());
+    }
+    Value element;
+    while (iterator->next(element, nullptr)) {
+        elements.push_back(element);
+    }
+    return elements;
+}
+
+
+static std::vector<std::shared_ptr<Scope>> isolatedScopes(const std::shared_ptr<Scope> &scope, size_t count) {
+    std::vector<std::shared_ptr<Scope>> scopes;
+    scopes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        scopes.push_back(scope->createIsolatedCopy());
+    }
+    return scopes;
+}
+
+
+Value parmap(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("pmap", arguments, 2);
+    auto function = functionArgument("pmap", arguments[0], scope);
+    const std::vector<Value> elements = collectElements(arguments[1]->evaluate(scope));
+
+    size_t n = elements.size(), chunks = std::min(ThreadPool::instance().size(), n);
+    auto scopes = isolatedScopes(scope, chunks);
+    std::vector<Value> results(n);
+    ThreadPool::instance().run(chunks, [&](size_t chunk) {
+        for (size_t i = n * chunk / chunks; i < n * (chunk + 1) / chunks; ++i) {
+            results[i] = callFunction(*function, {elements[i]}, scopes[chunk]);
+        }
+    });
+
+    ValueList list;
+    list.reserve(n);
+    for (const auto &result: results) {
+        list.push_back(result);
+    }
+    return Value(std::move(list));
+}
+
+
+// each chunk is reduced on its own and the partial results are combined in order, so the function must be associative
+Value parreduce(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("preduce", arguments, 3);
+    auto function = functionArgument("preduce", arguments[0], scope);
+    const std::vector<Value> elements = collectElements(arguments[1]->evaluate(scope));
+    Value accumulator = arguments[2]->evaluate(scope);
+
+    size_t n = elements.size(), chunks = std::min(ThreadPool::instance().size(), n);
+    auto scopes = isolatedScopes(scope, std::max<size_t>(chunks, 1));
+    std::vector<Value> partials(chunks);
+    ThreadPool::instance().run(chunks, [&](size_t chunk) {
+        size_t begin = n * chunk / chunks, end = n * (chunk + 1) / chunks;
+        Value partial = elements[begin];
+        for (size_t i = begin + 1; i < end; ++i) {
+            partial = callFunction(*function, {std::move(partial), elements[i]}, scopes[chunk]);
+        }
+        partials[chunk] = std::move(partial);
+    });
+
+    for (auto &partial: partials) {
+        accumulator = callFunction(*function, {std::move(accumulator), std::move(partial)}, scopes[0]);
+    }
+    return accumulator;
+}
+
+// memory
+
+Value gccollect(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &) {
+    expectArguments("gc", arguments, 0);
+    return Value(static_cast<long>(Collector::instance().collectAll()));
+}
+
+
+Value gcstats(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &) {
+    expectArguments("gcstats", arguments, 0);
+    Collector::Stats stats = Collector::instance().getStats();
+    auto micros = [](std::chrono::nanoseconds duration) {
+        return Value(static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+    };
+    ValueDict dict;
+    dict[std::string("collections")] = Value(static_cast<long>(stats.collections));
+    dict[std::string("full_collections")] = Value(static_cast<long>(stats.fullCollections));
+    dict[std::string("collected_scopes")] = Value(static_cast<long>(stats.collectedScopes));
+    dict[std::string("collected_bytes")] = Value(static_cast<long>(stats.collectedBytes));
+    dict[std::string("pause_us")] = micros(stats.totalPause);
+    dict[std::string("longest_pause_us")] = micros(stats.longestPause);
+    dict[std::string("live_scopes")] = Value(static_cast<long>(stats.liveScopes));
+    dict[std::string("heap_bytes")] = Value(static_cast<long>(stats.heapBytes));
+    return Value(std::move(dict));
+}
+
+
+Value heapdump(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("heapdump", arguments, 1);
+    Value path = arguments[0]->evaluate(scope);
+    if (!path.isBase() || !std::holds_alternative<std::string>(path.asBase())) {
+        throw TypeError("Function heapdump() expects a string path");
+    }
+    if (ThreadPool::inTask()) {
+        throw ValueError("Function heapdump() can't be called from a parallel function");
+    }
+    return Value(static_cast<long>(writeHeapDump(std::get<std::string>(path.asBase()), scope)));
+}
+
+
+Value runstats(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &) {
+    expectArguments("stats", arguments, 0);
+    auto totals = collectCounters();
+    ValueDict dict, nodes;
+    for (size_t i = 0; i < totals.size(); ++i) {
+        ValueDict &target = i < static_cast<size_t>(Counter::COUNT) ? dict : nodes;
+        target[totals[i].first] = Value(static_cast<long>(totals[i].second));
+    }
+    dict[std::string("nodes")] = Value(std::move(nodes));
+    return Value(std::move(dict));
+}
+
+// timing
+
+Value timeclock(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &) {
+    expectArguments("clock", arguments, 0);
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return Value(static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()));
+}
+
+
+Value timecpu(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &) {
+    expectArguments("cputime", arguments, 0);
+    timespec time{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return Value(time.tv_sec * 1000000000L + time.tv_nsec);
+}
+
+
+// the time of each of 'iterations' calls, after a tenth as many calls to warm up
+static std::vector<double> timeCalls(const Closure &function, long iterations, const std::shared_ptr<Scope> &scope) {
+    using Clock = std::chrono::steady_clock;
+    for (long i = 0; i < std::max(iterations / 10, 1L); ++i) {
+        callFunction(function, {}, scope);
+    }
+    std::vector<double> samples(iterations);
+    for (long i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        callFunction(function, {}, scope);
+        samples[i] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+    return samples;
+}
+
+
+static double median(std::vector<double> &samples) {
+    std::sort(samples.begin(), samples.end());
+    size_t middle = samples.size() / 2;
+    return samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+}
+
+
+// what is left of each call after taking away the median time of calling an empty function the same way, which covers
+// the call itself and reading the clock
+Value timebench(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+    expectArguments("bench", arguments, 2);
+    auto function = functionArgument("bench", arguments[0], scope);
+    Value count = arguments[1]->evaluate(scope);
+    if (!count.isBase() || !std::holds_alternative<long>(count.asBase())) {
+        throw TypeError("Function bench() expects an integer number of iterations");
+    }
+    long iterations = std::get<long>(count.asBase());
+    if (iterations <= 0) {
+        throw ValueError("Function bench() needs at least one iteration");
+    }
+
+    static const Closure empty{
+            "<empty>",
+            std::make_shared<FunctionDeclarationNode>(
+                    "<empty>", std::vector<std::string>(), false,
+                    std::make_unique<BlockNode>(std::vector<std::unique_ptr<ASTNode>>()), false,
+                    std::vector<std::string>()),
+            {}, {}};
+    std::vector<double> baseline = timeCalls(empty, iterations, scope);
+    double overhead = median(baseline);
+
+    std::vector<double> samples = timeCalls(*function, iterations, scope);
+    double sum = 0;
+    for (double &sample: samples) {
+        sample = std::max(sample - overhead, 0.0);
+        sum += sample;
+    }
+    double mean = sum / iterations, variance = 0;
+    for (double sample: samples) {
+        variance += (sample - mean) * (sample - mean);
+    }
+    variance = iterations > 1 ? variance / (iterations - 1) : 0;
+
+    ValueDict dict;
+    dict[std::string("iterations")] = Value(iterations);
+    dict[std::string("min_ns")] = Value(*std::min_element(samples.begin(), samples.end()));
+    dict[std::string("median_ns")] = Value(median(samples));
+    dict[std::string("mean_ns")] = Value(mean);
+    dict[std::string("stddev_ns")] = Value(std::sqrt(variance));
+    dict[std::string("overhead_ns")] = Value(overhead);
+    return Value(std::move(dict));
+}
+
 // methods
 
-Value listlen(Value& caller, const std::vector<std::unique_ptr<ASTNode>>& arguments) {
+Value listlen(const Value& caller, const std::vector<Value>& arguments) {
     if (!arguments.empty()) {
         throw ValueError("Method len() doesn't expect any arguments");
     }
@@ -113,20 +975,19 @@ Value listlen(Value& caller, const std::vector<std::unique_ptr<ASTNode>>& argume
 }
 
 
-void listappend(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+void listappend(Value& caller, const std::vector<Value> &arguments) {
     if (arguments.size() != 1) {
         throw ValueError("Method append() expects exactly 1 argument");
     }
-    Value argValue = arguments[0]->evaluate(scope);
-    caller.asList().push_back(std::make_shared<Value>(argValue));
+    caller.asList().push_back(arguments[0]);
 }
 
 
-void listremove(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+void listremove(Value& caller, const std::vector<Value> &arguments) {
     if (arguments.size() != 1) {
         throw ValueError("Method remove() expects exactly 1 argument");
     }
-    Value indexValue = arguments[0]->evaluate(scope);
+    const Value &indexValue = arguments[0];
     if (!indexValue.isBase() || !std::holds_alternative<long>(indexValue.asBase())) {
         throw TypeError("remove() method's argument must be an integer");
     }
@@ -134,28 +995,35 @@ void listremove(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &argu
     if (idx >= caller.asList().size() || idx < 0) {
         throw IndexError("Cannot remove: index (" + std::to_string(idx) + ") out of range");
     }
-    caller.asList().erase(caller.asList().begin() + idx);
+    caller.asList().erase(idx);
+}
+
+
+void listsort(Value& caller, const std::vector<Value> &arguments) {
+    if (!arguments.empty()) {
+        throw ValueError("Method sort() doesn't expect any arguments");
+    }
+    sortList(caller.asList(), false);
 }
 
 
-void listput(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+void listput(Value& caller, const std::vector<Value> &arguments) {
     if (arguments.size() != 2) {
         throw ValueError("Method put() expects exactly 2 arguments");
     }
-    Value indexValue = arguments[0]->evaluate(scope);
+    const Value &indexValue = arguments[0];
     if (!indexValue.isBase() || !std::holds_alternative<long>(indexValue.asBase())) {
         throw TypeError("put() method's first argument must be an integer");
     }
     long idx = std::get<long>(indexValue.asBase());
-    Value argValue = arguments[1]->evaluate(scope);
     if (idx > caller.asList().size() || idx < 0) {
         throw IndexError("Cannot put: index (" + std::to_string(idx) + ") out of range");
     }
-    caller.asList().insert(caller.asList().begin() + idx, std::make_shared<Value>(argValue));
+    caller.asList().insert(idx, arguments[1]);
 }
 
 
-Value dictsize(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments) {
+Value dictsize(const Value& caller, const std::vector<Value> &arguments) {
     if (!arguments.empty()) {
         throw ValueError("Method size() doesn't expect any arguments");
     }
@@ -163,82 +1031,224 @@ Value dictsize(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &argum
 }
 
 
-Value dictexists(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+Value dictexists(const Value& caller, const std::vector<Value> &arguments) {
     if (arguments.size() != 1) {
         throw ValueError("Method exists() expects exactly 1 argument");
     }
-    Value keyValue = arguments[0]->evaluate(scope);
+    const Value &keyValue = arguments[0];
     if (!keyValue.isBase()) {
         throw TypeError("Dictionary key must be a basic type");
     }
-    return Value(caller.asDict().find(keyValue.asBase()) != caller.asDict().end());
+    return Value(caller.asDict().find(keyValue.asBase()) != nullptr);
 }
 
 
-void dictremove(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+void dictremove(Value& caller, const std::vector<Value> &arguments) {
     if (arguments.size() != 1) {
         throw ValueError("Method remove() expects exactly 1 argument");
     }
-    Value keyValue = arguments[0]->evaluate(scope);
+    const Value &keyValue = arguments[0];
     if (!keyValue.isBase()) {
         throw TypeError("Dictionary key must be a basic type");
-    } else if (caller.asDict().erase(keyValue.asBase()) == 0) {
+    } else if (!caller.asDict().erase(keyValue.asBase())) {
         throw NameError("Dictionary key not found");
     }
 }
 
 
-Value slen(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments) {
+Value slen(const Value& caller, const std::vector<Value> &arguments) {
     if (!arguments.empty()) {
         throw ValueError("Method len() doesn't expect any arguments");
     }
-    return Value(static_cast<long>(getStrLen(std::get<std::string>(caller.asBase()))));
+    return Value(static_cast<long>(caller.strIndex().charCount(std::get<std::string>(caller.asBase()))));
+}
+
+
+// the string argument or a TypeError with the given message
+static const std::string &expectString(const Value &argValue, const std::string &message) {
+    if (!argValue.isBase() || !std::holds_alternative<std::string>(argValue.asBase())) {
+        throw TypeError(message);
+    }
+    return std::get<std::string>(argValue.asBase());
 }
 
 
-void sltrim(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+// an ASCII set is a byte lookup table, so trimming never decodes the string
+static bool isTrimmed(const std::string &trimChars, const bool *asciiSet, std::string_view character) {
+    if (asciiSet) {
+        return character.size() == 1 && asciiSet[static_cast<unsigned char>(character[0])];
+    }
+    return std::string_view(trimChars).find(character) != std::string_view::npos;
+}
+
+
+void sltrim(Value& caller, const std::vector<Value> &arguments) {
     if (arguments.size() != 1) {
         throw ValueError("Method ltrim() expects exactly 1 argument");
     }
-    Value argValue = arguments[0]->evaluate(scope);
-    if (!argValue.isBase() || !std::holds_alternative<std::string>(argValue.asBase())) {
-        throw TypeError("ltrim() method's argument must be a string");
-    }
-    std::string trimChars = std::get<std::string>(argValue.asBase());
-    std::string base = std::get<std::string>(caller.asBase());
-    std::string currChar;
-    size_t start = 0, bsize = base.size(), i = 0;
-    while (start < bsize) {
-        currChar = getStrChar(base, i);
-        if (trimChars.find(currChar) == std::string::npos) {
+    const std::string &trimChars = expectString(arguments[0], "ltrim() method's argument must be a string");
+    bool table[256] = {};
+    const bool *asciiSet = nullptr;
+    if (isAscii(trimChars.data(), trimChars.size())) {
+        for (unsigned char c: trimChars) table[c] = true;
+        asciiSet = table;
+    }
+    const std::string &base = std::get<std::string>(std::as_const(caller).asBase());
+    size_t start = 0;
+    while (start < base.size()) {
+        size_t width = utf8CharWidth(base[start]);
+        if (!isTrimmed(trimChars, asciiSet, std::string_view(base).substr(start, width))) {
             break;
         }
-        start += currChar.size();
-        ++i;
+        start += width;
+    }
+    if (start > 0) {
+        std::get<std::string>(caller.asBase()).erase(0, start);
+        caller.recharge();
     }
-    caller = Value(base.substr(start));
 }
 
 
-void srtrim(Value& caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope) {
+void srtrim(Value& caller, const std::vector<Value> &arguments) {
     if (arguments.size() != 1) {
         throw ValueError("Method rtrim() expects exactly 1 argument");
     }
-    Value argValue = arguments[0]->evaluate(scope);
-    if (!argValue.isBase() || !std::holds_alternative<std::string>(argValue.asBase())) {
-        throw TypeError("rtrim() method's argument must be a string");
+    const std::string &trimChars = expectString(arguments[0], "rtrim() method's argument must be a string");
+    bool table[256] = {};
+    const bool *asciiSet = nullptr;
+    if (isAscii(trimChars.data(), trimChars.size())) {
+        for (unsigned char c: trimChars) table[c] = true;
+        asciiSet = table;
     }
-    std::string trimChars = std::get<std::string>(argValue.asBase());
-    std::string base = std::get<std::string>(caller.asBase());
-    std::string currChar;
-    size_t end = base.size(), i = end - 1;
+    const std::string &base = std::get<std::string>(std::as_const(caller).asBase());
+    size_t end = base.size();
     while (end > 0) {
-        currChar = getStrChar(base, i);
-        if (trimChars.find(currChar) == std::string::npos) {
+        // step back over continuation bytes to the start of the last character
+        size_t begin = end - 1;
+        while (begin > 0 && (static_cast<unsigned char>(base[begin]) & 0xC0) == 0x80) {
+            --begin;
+        }
+        if (!isTrimmed(trimChars, asciiSet, std::string_view(base).substr(begin, end - begin))) {
+            break;
+        }
+        end = begin;
+    }
+    if (end < base.size()) {
+        std::get<std::string>(caller.asBase()).resize(end);
+        caller.recharge();
+    }
+}
+
+
+void sreplace(Value& caller, const std::vector<Value> &arguments) {
+    if (arguments.size() != 2) {
+        throw ValueError("Method replace() expects exactly 2 arguments");
+    }
+    const std::string &from = expectString(arguments[0], "replace() method's arguments must be strings");
+    const std::string &to = expectString(arguments[1], "replace() method's arguments must be strings");
+    if (from.empty()) {
+        throw ValueError("replace() method's first argument cannot be empty");
+    }
+    const std::string &base = std::get<std::string>(std::as_const(caller).asBase());
+    size_t pos = findBytes(base.data(), base.size(), from.data(), from.size());
+    if (pos == std::string::npos) {
+        return;
+    }
+    std::string result;
+    result.reserve(base.size());
+    size_t last = 0;
+    while (pos != std::string::npos) {
+        result.append(base, last, pos - last);
+        result += to;
+        last = pos + from.size();
+        size_t next = findBytes(base.data() + last, base.size() - last, from.data(), from.size());
+        pos = next == std::string::npos ? next : last + next;
+    }
+    result.append(base, last, std::string::npos);
+    caller = Value(std::move(result));
+}
+
+
+Value sfind(const Value& caller, const std::vector<Value> &arguments) {
+    if (arguments.size() != 1) {
+        throw ValueError("Method find() expects exactly 1 argument");
+    }
+    const std::string &needle = expectString(arguments[0], "find() method's argument must be a string");
+    const std::string &base = std::get<std::string>(caller.asBase());
+    size_t pos = findBytes(base.data(), base.size(), needle.data(), needle.size());
+    if (pos == std::string::npos) {
+        return Value(-1L);
+    }
+    // a byte offset is a character index only in an ASCII string
+    if (caller.strIndex().charCount(base) != base.size()) {
+        pos = countUtf8Chars(base.data(), pos);
+    }
+    return Value(static_cast<long>(pos));
+}
+
+
+Value sstartswith(const Value& caller, const std::vector<Value> &arguments) {
+    if (arguments.size() != 1) {
+        throw ValueError("Method startswith() expects exactly 1 argument");
+    }
+    const std::string &prefix = expectString(arguments[0], "startswith() method's argument must be a string");
+    const std::string &base = std::get<std::string>(caller.asBase());
+    return Value(base.compare(0, prefix.size(), prefix) == 0);
+}
+
+
+Value ssplit(const Value& caller, const std::vector<Value> &arguments) {
+    if (arguments.size() != 1) {
+        throw ValueError("Method split() expects exactly 1 argument");
+    }
+    const std::string &separator = expectString(arguments[0], "split() method's argument must be a string");
+    if (separator.empty()) {
+        throw ValueError("split() method's separator cannot be empty");
+    }
+    const std::string &base = std::get<std::string>(caller.asBase());
+    ValueList parts;
+    size_t last = 0;
+    while (true) {
+        size_t next = findBytes(base.data() + last, base.size() - last, separator.data(), separator.size());
+        if (next == std::string::npos) {
             break;
         }
-        end -= currChar.size();
-        --i;
+        parts.push_back(Value(base.substr(last, next)));
+        last += next + separator.size();
+    }
+    parts.push_back(Value(base.substr(last)));
+    return Value(std::move(parts));
+}
+
+
+Value sjoin(const Value& caller, const std::vector<Value> &arguments) {
+    if (arguments.size() != 1) {
+        throw ValueError("Method join() expects exactly 1 argument");
+    }
+    const Value &listValue = arguments[0];
+    if (!listValue.isList()) {
+        throw TypeError("join() method's argument must be a list of strings");
+    }
+    const ValueList &list = listValue.asList();
+    if (list.empty()) {
+        return Value(std::string());
+    }
+    const Storage<Value> *elements = list.boxed();
+    if (!elements) {
+        throw TypeError("join() method's argument must be a list of strings");
+    }
+    const std::string &separator = std::get<std::string>(caller.asBase());
+    size_t total = separator.size() * (elements->size() - 1);
+    for (const auto &element: *elements) {
+        total += expectString(element, "join() method's argument must be a list of strings").size();
+    }
+    std::string result;
+    result.reserve(total);
+    for (size_t i = 0; i < elements->size(); ++i) {
+        if (i > 0) {
+            result += separator;
+        }
+        result += std::get<std::string>((*elements)[i].asBase());
     }
-    caller = Value(base.substr(0, end));
+    return Value(std::move(result));
 }
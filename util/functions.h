@@ -8,6 +8,18 @@ class ASTNode;
 class Scope;
 class Value;
 
+using BuiltinFunction = Value (*)(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+struct Builtin {
+    BuiltinFunction function;
+    // the language's original built-in functions can't be redefined. The later ones have common names like sum or
+    // add, so a user's function or function value with the same name hides them instead
+    bool reserved;
+};
+
+// nullptr if there is no built-in function with that name
+const Builtin *getBuiltinFunction(const std::string &name);
+
 // functions
 
 Value print(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
@@ -22,27 +34,115 @@ Value floori(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared
 
 Value ceili(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
 
+// numeric list functions
+
+Value listsum(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listmin(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listmax(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listmean(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listdot(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listadd(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listmul(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listscale(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listabs(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listsqrt(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// lazy sequences
+
+Value seqrange(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value seqmap(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value seqfilter(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value seqtake(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value seqzip(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value seqreduce(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value seqlist(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// sorting
+
+Value listsorted(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value listpsort(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// parallel functions
+
+Value parmap(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+Value parreduce(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// memory
+
+// a full cycle collection; returns the number of scopes it freed
+Value gccollect(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// the collector's counters, as a dictionary
+Value gcstats(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// writes the heap profile to a file and returns the live bytes it counted
+Value heapdump(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// the interpreter's counters summed over all threads, as a dictionary with the evaluations per node kind under "nodes"
+Value runstats(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// timing
+
+// a monotonic clock, in nanoseconds
+Value timeclock(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// the CPU time the process has used, in nanoseconds
+Value timecpu(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
+// times calls to a function without parameters, and returns the min, median, mean and standard deviation in
+// nanoseconds as a dictionary
+Value timebench(const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+
 // methods
 
-Value listlen(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments);
+Value listlen(const Value &caller, const std::vector<Value> &arguments);
+
+void listappend(Value &caller, const std::vector<Value> &arguments);
+
+void listremove(Value &caller, const std::vector<Value> &arguments);
+
+void listsort(Value &caller, const std::vector<Value> &arguments);
+
+void listput(Value &caller, const std::vector<Value> &arguments);
+
+Value dictsize(const Value &caller, const std::vector<Value> &arguments);
+
+Value dictexists(const Value &caller, const std::vector<Value> &arguments);
 
-void listappend(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+void dictremove(Value &caller, const std::vector<Value> &arguments);
 
-void listremove(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+Value slen(const Value &caller, const std::vector<Value> &arguments);
 
-void listput(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+void sltrim(Value &caller, const std::vector<Value> &arguments);
 
-Value dictsize(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments);
+void srtrim(Value &caller, const std::vector<Value> &arguments);
 
-Value dictexists(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+void sreplace(Value &caller, const std::vector<Value> &arguments);
 
-void dictremove(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+Value sfind(const Value &caller, const std::vector<Value> &arguments);
 
-Value slen(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments);
+Value sstartswith(const Value &caller, const std::vector<Value> &arguments);
 
-void sltrim(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+Value ssplit(const Value &caller, const std::vector<Value> &arguments);
 
-void srtrim(Value &caller, const std::vector<std::unique_ptr<ASTNode>> &arguments, std::shared_ptr<Scope> &scope);
+Value sjoin(const Value &caller, const std::vector<Value> &arguments);
 
 
 #endif
\ No newline at end of file
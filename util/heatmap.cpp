@@ -0,0 +1,147 @@
+#include "heatmap.h"
+#include "../core/main/ast.h"
+#include <algorithm>
+#include <cxxabi.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <typeindex>
+#include <unordered_map>
+
+
+thread_local constinit bool heatmapThread = false;
+
+struct LineStats {
+    uint64_t count = 0;
+    std::chrono::nanoseconds time{0};
+    // how many executions are in progress
+    uint32_t active = 0;
+};
+
+// indexed by line
+static std::vector<LineStats> lines;
+static std::unordered_map<std::type_index, LineStats> kinds;
+static std::string output;
+static std::chrono::steady_clock::time_point started;
+
+
+void LineProbe::begin(const ASTNode &node) {
+    statement = &node;
+    if (node.getLine() >= lines.size()) {
+        lines.resize(node.getLine() + 1);
+    }
+    LineStats &line = lines[node.getLine()];
+    LineStats &kind = kinds[typeid(node)];
+    ++line.count;
+    ++kind.count;
+    outermostLine = line.active++ == 0;
+    outermostKind = kind.active++ == 0;
+    start = std::chrono::steady_clock::now();
+}
+
+
+void LineProbe::end() {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    // the vector may have grown since begin()
+    LineStats &line = lines[statement->getLine()];
+    LineStats &kind = kinds[typeid(*statement)];
+    --line.active;
+    --kind.active;
+    if (outermostLine) {
+        line.time += elapsed;
+    }
+    if (outermostKind) {
+        kind.time += elapsed;
+    }
+}
+
+
+void startHeatmap(const std::string &outputPath) {
+    output = outputPath;
+    heatmapThread = true;
+    started = std::chrono::steady_clock::now();
+}
+
+
+static std::string kindName(const std::type_index &type) {
+    int status;
+    char *demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : type.name();
+    std::free(demangled);
+    return name;
+}
+
+
+static std::string jsonString(const std::string &text) {
+    std::string quoted = "\"";
+    for (char c: text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+
+void stopHeatmap(const std::vector<std::string> &source) {
+    if (!heatmapThread) {
+        return;
+    }
+    heatmapThread = false;
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    auto seconds = [](const LineStats &counter) { return std::chrono::duration<double>(counter.time).count(); };
+    auto percent = [&](const LineStats &counter) { return total > 0 ? 100 * seconds(counter) / total : 0; };
+
+    std::vector<std::pair<std::string, LineStats>> byKind;
+    for (const auto &[type, counter]: kinds) {
+        byKind.emplace_back(kindName(type), counter);
+    }
+    std::sort(byKind.begin(), byKind.end(), [](const auto &a, const auto &b) { return a.second.time > b.second.time; });
+    lines.resize(std::max(lines.size(), source.size() + 1));
+
+    std::cerr << std::fixed << std::setprecision(3) << "Heatmap: " << total << "s in total\n"
+              << "      count      time       %  line\n";
+    for (size_t i = 1; i <= source.size(); ++i) {
+        if (lines[i].count) {
+            std::cerr << std::setw(11) << lines[i].count << std::setw(9) << seconds(lines[i]) << 's'
+                      << std::setprecision(1) << std::setw(7) << percent(lines[i]) << '%' << std::setprecision(3);
+        } else {
+            std::cerr << std::string(29, ' ');
+        }
+        std::cerr << std::setw(6) << i << " | " << source[i - 1] << '\n';
+    }
+    std::cerr << "\n      count      time       %  node kind\n";
+    for (const auto &[name, counter]: byKind) {
+        std::cerr << std::setw(11) << counter.count << std::setw(9) << seconds(counter) << 's' << std::setprecision(1)
+                  << std::setw(7) << percent(counter) << '%' << std::setprecision(3) << "  " << name << '\n';
+    }
+
+    std::ofstream file(output);
+    file << std::fixed << std::setprecision(6) << "{\n  \"total_seconds\": " << total << ",\n  \"lines\": [";
+    bool first = true;
+    for (size_t i = 1; i < lines.size(); ++i) {
+        if (!lines[i].count) {
+            continue;
+        }
+        file << (first ? "\n" : ",\n") << "    {\"line\": " << i << ", \"count\": " << lines[i].count
+             << ", \"seconds\": " << seconds(lines[i]) << ", \"percent\": " << percent(lines[i]) << ", \"source\": "
+             << jsonString(i <= source.size() ? source[i - 1] : "") << '}';
+        first = false;
+    }
+    file << "\n  ],\n  \"kinds\": [";
+    first = true;
+    for (const auto &[name, counter]: byKind) {
+        file << (first ? "\n" : ",\n") << "    {\"kind\": " << jsonString(name) << ", \"count\": " << counter.count
+             << ", \"seconds\": " << seconds(counter) << ", \"percent\": " << percent(counter) << '}';
+        first = false;
+    }
+    file << "\n  ]\n}\n";
+    std::cerr << "Heatmap written to " << output << std::endl;
+}
@@ -0,0 +1,54 @@
+#ifndef CPP_INTERPRETER_HEATMAP_H
+#define CPP_INTERPRETER_HEATMAP_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+class ASTNode;
+
+// true on the thread whose statements the heatmap counts; the parallel builtins' workers are left out, and their time
+// lands on the line that called them
+extern thread_local constinit bool heatmapThread;
+
+// counts one execution of a statement and adds the time it took, for as long as it exists. Time is inclusive, but a
+// line or node kind that is already running further up, like a recursive call, isn't counted twice
+class LineProbe {
+private:
+    const ASTNode *statement = nullptr;
+    std::chrono::steady_clock::time_point start;
+    bool outermostLine = false, outermostKind = false;
+
+    void begin(const ASTNode &node);
+
+    void end();
+
+public:
+    explicit LineProbe(const ASTNode &node) {
+        if (heatmapThread) {
+            begin(node);
+        }
+    }
+
+    ~LineProbe() {
+        if (statement) {
+            end();
+        }
+    }
+
+    LineProbe(const LineProbe &) = delete;
+
+    LineProbe &operator=(const LineProbe &) = delete;
+};
+
+// starts counting the statements the calling thread runs
+void startHeatmap(const std::string &outputPath);
+
+// prints the source with every line's execution count and share of the run time, followed by the totals per node kind,
+// and writes the same numbers as JSON. source holds the program's lines, the first one being line 1
+void stopHeatmap(const std::vector<std::string> &source);
+
+
+#endif
@@ -0,0 +1,69 @@
+#include "pool.h"
+#include <new>
+
+
+static constexpr size_t GRANULE = 16;
+static constexpr size_t CLASSES = 16;
+// blocks beyond this many per size go back to the heap, so a burst of allocations isn't held on to for good
+static constexpr size_t MAX_CACHED = 4096;
+
+struct FreeBlock {
+    FreeBlock *next;
+};
+
+struct FreeLists {
+    FreeBlock *heads[CLASSES] = {};
+    size_t counts[CLASSES] = {};
+
+    ~FreeLists();
+};
+
+static thread_local FreeLists freeLists;
+// blocks freed while the thread is shutting down, after its lists are gone, go straight back to the heap
+static thread_local bool listsDestroyed = false;
+
+
+FreeLists::~FreeLists() {
+    for (auto &head: heads) {
+        while (head) {
+            FreeBlock *block = head;
+            head = block->next;
+            ::operator delete(block);
+        }
+    }
+    listsDestroyed = true;
+}
+
+
+static size_t sizeClass(size_t bytes) {
+    return bytes ? (bytes - 1) / GRANULE : 0;
+}
+
+
+void *poolAllocate(size_t bytes) {
+    size_t c = sizeClass(bytes);
+    if (c >= CLASSES) {
+        return ::operator new(bytes);
+    }
+    if (!listsDestroyed) {
+        if (FreeBlock *block = freeLists.heads[c]) {
+            freeLists.heads[c] = block->next;
+            --freeLists.counts[c];
+            return block;
+        }
+    }
+    return ::operator new((c + 1) * GRANULE);
+}
+
+
+void poolFree(void *block, size_t bytes) {
+    size_t c = sizeClass(bytes);
+    if (c >= CLASSES || listsDestroyed || freeLists.counts[c] >= MAX_CACHED) {
+        ::operator delete(block);
+        return;
+    }
+    auto freeBlock = static_cast<FreeBlock *>(block);
+    freeBlock->next = freeLists.heads[c];
+    freeLists.heads[c] = freeBlock;
+    ++freeLists.counts[c];
+}
@@ -0,0 +1,36 @@
+#ifndef CPP_INTERPRETER_POOL_H
+#define CPP_INTERPRETER_POOL_H
+
+#include <cstddef>
+
+
+// blocks of up to 256 bytes are recycled through free lists kept per thread, so the objects every block, loop
+// iteration and function call creates and drops again, like scopes and their variables, skip the general-purpose heap.
+// a block freed on another thread than the one that allocated it simply joins that thread's lists
+void *poolAllocate(size_t bytes);
+
+void poolFree(void *block, size_t bytes);
+
+template<typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(poolAllocate(n * sizeof(T))); }
+
+    void deallocate(T *block, size_t n) { poolFree(block, n * sizeof(T)); }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U> &) const { return true; }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
+
+
+#endif
@@ -0,0 +1,150 @@
+#include "profiler.h"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sys/time.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+thread_local constinit CallStack callStack{};
+
+static std::mutex labelMutex;
+static std::vector<std::string> labelNames;
+
+
+uint32_t profileLabel(const std::string &name) {
+    std::lock_guard<std::mutex> lock(labelMutex);
+    static std::unordered_map<std::string, uint32_t> labels;
+    auto [it, added] = labels.emplace(name, labelNames.size());
+    if (added) {
+        labelNames.push_back(name);
+    }
+    return it->second;
+}
+
+
+std::string labelName(uint32_t label) {
+    std::lock_guard<std::mutex> lock(labelMutex);
+    return labelNames[label];
+}
+
+
+// the signal handler writes samples to a ring that a collector thread drains, since it can't allocate or lock
+struct Sample {
+    uint32_t depth;
+    StackEntry entries[CallStack::MAX_DEPTH];
+};
+
+static constexpr size_t RING_SIZE = 1024;
+static constexpr long INTERVAL_MICROSECONDS = 1000;
+
+static Sample ring[RING_SIZE];
+static std::atomic<size_t> writeCount{0}, readCount{0}, dropped{0};
+
+static std::string output;
+static std::map<std::string, size_t> stacks;
+static size_t sampleCount = 0;
+static std::thread collector;
+static std::atomic<bool> collecting{false};
+
+
+static void takeSample(int) {
+    size_t at = writeCount.load(std::memory_order_relaxed);
+    if (at - readCount.load(std::memory_order_acquire) >= RING_SIZE) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Sample &sample = ring[at % RING_SIZE];
+    sample.depth = callStack.depth;
+    std::atomic_signal_fence(std::memory_order_acquire);
+    std::memcpy(sample.entries, callStack.entries,
+                std::min(sample.depth, CallStack::MAX_DEPTH) * sizeof(StackEntry));
+    writeCount.store(at + 1, std::memory_order_release);
+}
+
+
+void blockSamples() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+}
+
+
+static void drain() {
+    size_t end = writeCount.load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lock(labelMutex);
+    for (size_t at = readCount.load(std::memory_order_relaxed); at < end; ++at) {
+        const Sample &sample = ring[at % RING_SIZE];
+        std::string stack;
+        for (uint32_t i = 0; i < std::min(sample.depth, CallStack::MAX_DEPTH); ++i) {
+            if (i) {
+                stack += ';';
+            }
+            stack += labelNames[sample.entries[i].label] + ':' + std::to_string(sample.entries[i].line);
+        }
+        if (sample.depth > CallStack::MAX_DEPTH) {
+            stack += ";[deeper frames]";
+        }
+        if (!stack.empty()) {
+            ++stacks[stack];
+            ++sampleCount;
+        }
+        readCount.store(at + 1, std::memory_order_release);
+    }
+}
+
+
+bool startProfiler(const std::string &outputPath) {
+    output = outputPath;
+    collecting = true;
+    collector = std::thread([] {
+        blockSamples();
+        while (collecting) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            drain();
+        }
+    });
+
+    struct sigaction action{};
+    action.sa_handler = takeSample;
+    // so reads from stdin carry on after a sample instead of failing
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    itimerval timer{{0, INTERVAL_MICROSECONDS}, {0, INTERVAL_MICROSECONDS}};
+    if (sigaction(SIGPROF, &action, nullptr) != 0 || setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        collecting = false;
+        collector.join();
+        return false;
+    }
+    return true;
+}
+
+
+void stopProfiler() {
+    if (!collector.joinable()) {
+        return;
+    }
+    itimerval off{};
+    setitimer(ITIMER_PROF, &off, nullptr);
+    signal(SIGPROF, SIG_IGN);
+    collecting = false;
+    collector.join();
+    drain();
+
+    std::ofstream file(output);
+    for (const auto &[stack, count]: stacks) {
+        file << stack << ' ' << count << '\n';
+    }
+    std::cerr << "Profile: " << sampleCount << " samples written to " << output;
+    if (dropped) {
+        std::cerr << " (" << dropped << " dropped)";
+    }
+    std::cerr << std::endl;
+}
@@ -0,0 +1,77 @@
+#ifndef CPP_INTERPRETER_PROFILER_H
+#define CPP_INTERPRETER_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+// one entry of a script-level call stack: a function call, or a generator resuming its body, and the line it is running
+struct StackEntry {
+    uint32_t label;
+    uint32_t line;
+};
+
+// the script-level call stack of a thread. The sampling profiler reads it from a signal handler, so entries are written
+// before depth counts them. Entries past MAX_DEPTH are counted but not recorded
+struct CallStack {
+    static constexpr uint32_t MAX_DEPTH = 128;
+
+    StackEntry entries[MAX_DEPTH];
+    volatile uint32_t depth;
+};
+
+extern thread_local constinit CallStack callStack;
+
+// a small number standing for the name, which stays valid for the whole run
+uint32_t profileLabel(const std::string &name);
+
+// the name a label stands for
+std::string labelName(uint32_t label);
+
+// an entry on the current thread's call stack for as long as it exists
+class StackFrame {
+public:
+    explicit StackFrame(uint32_t label) {
+        uint32_t depth = callStack.depth;
+        if (depth < CallStack::MAX_DEPTH) {
+            callStack.entries[depth] = {label, 0};
+        }
+        std::atomic_signal_fence(std::memory_order_release);
+        callStack.depth = depth + 1;
+    }
+
+    ~StackFrame() { callStack.depth = callStack.depth - 1; }
+
+    StackFrame(const StackFrame &) = delete;
+
+    StackFrame &operator=(const StackFrame &) = delete;
+};
+
+// records the line the innermost entry is running
+inline void setCurrentLine(uint32_t line) {
+    uint32_t depth = callStack.depth;
+    if (depth && depth <= CallStack::MAX_DEPTH) {
+        callStack.entries[depth - 1].line = line;
+    }
+}
+
+// the line the innermost entry is running, or 0 if the stack is empty
+inline uint32_t currentLine() {
+    uint32_t depth = callStack.depth;
+    return depth && depth <= CallStack::MAX_DEPTH ? callStack.entries[depth - 1].line : 0;
+}
+
+// samples the main thread's call stack on a SIGPROF timer, about once per millisecond of CPU time the process uses.
+// time the parallel builtins' workers spend is sampled there too, since they block the signal. False if the timer couldn't be set up
+bool startProfiler(const std::string &outputPath);
+
+// keeps the calling thread from taking samples, so that they all land on the thread running the script
+void blockSamples();
+
+// stops sampling and writes the samples as folded stacks, one "frame;frame;frame count" line per distinct stack, which
+// is what flamegraph.pl reads. A frame is a label and the line it was running, like "fib:3"
+void stopProfiler();
+
+
+#endif
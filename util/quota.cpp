@@ -0,0 +1,66 @@
+#include "quota.h"
+#include "errors.h"
+#include "profiler.h"
+#include <atomic>
+#include <iostream>
+
+
+bool quotaEnabled = false;
+
+thread_local constinit long quotaCredit = 0;
+
+// how much a thread takes from the quota at a time. It gives back what it holds beyond twice this
+static constexpr long SHARE = 16 * 1024;
+
+static long limit = 0;
+// what the threads have taken from the quota, both for allocations and as credit
+static std::atomic<long> reserved{0};
+static std::atomic<long> peak{0};
+
+
+void drawQuota(size_t bytes) {
+    // the credit is negative by what the allocation is short of
+    long wanted = SHARE - quotaCredit;
+    long total = reserved.fetch_add(wanted, std::memory_order_relaxed) + wanted;
+    if (total > limit) {
+        reserved.fetch_sub(wanted, std::memory_order_relaxed);
+        quotaCredit += static_cast<long>(bytes);
+        throw MemoryError("Memory limit of " + std::to_string(limit) + " bytes exceeded at line " +
+                          std::to_string(currentLine()));
+    }
+    quotaCredit += wanted;
+    long previous = peak.load(std::memory_order_relaxed);
+    while (total > previous && !peak.compare_exchange_weak(previous, total, std::memory_order_relaxed)) {}
+}
+
+
+void returnQuota() {
+    long surplus = quotaCredit - SHARE;
+    quotaCredit = SHARE;
+    reserved.fetch_sub(surplus, std::memory_order_relaxed);
+}
+
+
+void releaseQuota(size_t bytes) {
+    if (quotaEnabled && (quotaCredit += static_cast<long>(bytes)) > 2 * SHARE) {
+        returnQuota();
+    }
+}
+
+
+void setMemoryLimit(size_t bytes) {
+    limit = static_cast<long>(bytes);
+    quotaEnabled = true;
+}
+
+
+size_t peakMemory() {
+    return peak.load(std::memory_order_relaxed);
+}
+
+
+void printMemoryUsage() {
+    if (quotaEnabled) {
+        std::cerr << "Peak memory: " << peakMemory() << " of " << limit << " bytes" << std::endl;
+    }
+}
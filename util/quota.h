@@ -0,0 +1,78 @@
+#ifndef CPP_INTERPRETER_QUOTA_H
+#define CPP_INTERPRETER_QUOTA_H
+
+#include <cstddef>
+#include <memory>
+
+
+// true once a memory limit is set, which is decided before the program starts and never changes
+extern bool quotaEnabled;
+
+// the bytes this thread may still allocate before it takes more from the run's quota
+extern thread_local constinit long quotaCredit;
+
+// takes a new share of the quota for an allocation of 'bytes' that the thread's credit didn't cover. Throws
+// MemoryError, with the credit left as it was, if the quota can't cover it
+void drawQuota(size_t bytes);
+
+// gives a thread's surplus credit back to the quota
+void returnQuota();
+
+// charges an allocation to the quota
+inline void chargeQuota(size_t bytes) {
+    if (quotaEnabled && (quotaCredit -= static_cast<long>(bytes)) < 0) {
+        drawQuota(bytes);
+    }
+}
+
+void releaseQuota(size_t bytes);
+
+// limits the strings, list and dictionary storage and scopes a run holds at once to 'bytes'
+void setMemoryLimit(size_t bytes);
+
+// the most the run has held at once, to within the shares threads take at a time
+size_t peakMemory();
+
+// prints the peak against the limit to stderr
+void printMemoryUsage();
+
+// an allocator that charges what it hands out to the quota, and gets the memory from Upstream
+template<typename T, typename Upstream = std::allocator<T>>
+class QuotaAllocator : private Upstream {
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = QuotaAllocator<U, typename std::allocator_traits<Upstream>::template rebind_alloc<U>>;
+    };
+
+    QuotaAllocator() = default;
+
+    template<typename U, typename UpstreamU>
+    QuotaAllocator(const QuotaAllocator<U, UpstreamU> &) {}
+
+    T *allocate(size_t n) {
+        chargeQuota(n * sizeof(T));
+        try {
+            return Upstream::allocate(n);
+        } catch (...) {
+            releaseQuota(n * sizeof(T));
+            throw;
+        }
+    }
+
+    void deallocate(T *block, size_t n) {
+        Upstream::deallocate(block, n);
+        releaseQuota(n * sizeof(T));
+    }
+
+    template<typename U, typename UpstreamU>
+    bool operator==(const QuotaAllocator<U, UpstreamU> &) const { return true; }
+
+    template<typename U, typename UpstreamU>
+    bool operator!=(const QuotaAllocator<U, UpstreamU> &) const { return false; }
+};
+
+
+#endif
@@ -0,0 +1,532 @@
+#include "simd.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+
+static std::atomic<bool> simdAllowed{true};
+
+
+void useSimd(bool enabled) {
+    simdAllowed.store(enabled, std::memory_order_relaxed);
+}
+
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_AVX2
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+static_assert(sizeof(long) == 8, "AVX2 integer kernels assume 64-bit long");
+
+static bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported && simdAllowed.load(std::memory_order_relaxed);
+}
+#endif
+
+
+static bool fitsLong(__int128 v) {
+    return v >= LONG_MIN && v <= LONG_MAX;
+}
+
+// scalar kernels
+
+// an exact 128-bit accumulator: only a total that doesn't fit in an int is an overflow, not a partial sum
+static bool sumIntsScalar(const long *xs, size_t n, long &result) {
+    __int128 acc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        acc += xs[i];
+    }
+    if (!fitsLong(acc)) {
+        return false;
+    }
+    result = static_cast<long>(acc);
+    return true;
+}
+
+
+static double sumFloatsScalar(const double *xs, size_t n) {
+    double acc = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        acc += xs[i];
+    }
+    return acc;
+}
+
+
+static bool dotIntsScalar(const long *xs, const long *ys, size_t n, long &result) {
+    __int128 acc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (__builtin_add_overflow(acc, static_cast<__int128>(xs[i]) * ys[i], &acc)) {
+            return false;
+        }
+    }
+    if (!fitsLong(acc)) {
+        return false;
+    }
+    result = static_cast<long>(acc);
+    return true;
+}
+
+
+static double dotFloatsScalar(const double *xs, const double *ys, size_t n) {
+    double acc = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        acc += xs[i] * ys[i];
+    }
+    return acc;
+}
+
+
+static bool addIntsScalar(const long *xs, const long *ys, long *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (__builtin_add_overflow(xs[i], ys[i], &out[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool isAsciiScalar(const char *data, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (static_cast<unsigned char>(data[i]) & 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static size_t countUtf8CharsScalar(const char *data, size_t n) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += (static_cast<unsigned char>(data[i]) & 0xC0) != 0x80;
+    }
+    return count;
+}
+
+
+static size_t findBytesScalar(const char *haystack, size_t n, const char *needle, size_t m) {
+    return std::string_view(haystack, n).find(std::string_view(needle, m));
+}
+
+
+static bool absIntsScalar(const long *xs, long *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (xs[i] == LONG_MIN) {
+            return false;
+        }
+        out[i] = std::abs(xs[i]);
+    }
+    return true;
+}
+
+// AVX2 kernels
+
+#ifdef SIMD_AVX2
+
+AVX2_TARGET static bool sumIntsAvx2(const long *xs, size_t n, long &result) {
+    __m256i acc = _mm256_setzero_si256();
+    __m256i overflow = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xs + i));
+        __m256i sum = _mm256_add_epi64(acc, x);
+        // signed overflow: both operands differ in sign from the result
+        overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(acc, sum), _mm256_xor_si256(x, sum)));
+        acc = sum;
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow))) {
+        // a lane overflowing doesn't mean the total does
+        return sumIntsScalar(xs, n, result);
+    }
+    alignas(32) long lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+    __int128 total = static_cast<__int128>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; ++i) {
+        total += xs[i];
+    }
+    if (!fitsLong(total)) {
+        return false;
+    }
+    result = static_cast<long>(total);
+    return true;
+}
+
+
+AVX2_TARGET static double sumFloatsAvx2(const double *xs, size_t n) {
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm256_add_pd(acc, _mm256_loadu_pd(xs + i));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, acc);
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; ++i) {
+        total += xs[i];
+    }
+    return total;
+}
+
+
+AVX2_TARGET static long extremeIntsAvx2(const long *xs, size_t n, bool max) {
+    __m256i best = _mm256_set1_epi64x(xs[0]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xs + i));
+        __m256i replace = max ? _mm256_cmpgt_epi64(x, best) : _mm256_cmpgt_epi64(best, x);
+        best = _mm256_blendv_epi8(best, x, replace);
+    }
+    alignas(32) long lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), best);
+    long result = max ? *std::max_element(lanes, lanes + 4) : *std::min_element(lanes, lanes + 4);
+    for (; i < n; ++i) {
+        result = max ? std::max(result, xs[i]) : std::min(result, xs[i]);
+    }
+    return result;
+}
+
+
+AVX2_TARGET static double extremeFloatsAvx2(const double *xs, size_t n, bool max) {
+    __m256d best = _mm256_set1_pd(xs[0]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(xs + i);
+        best = max ? _mm256_max_pd(best, x) : _mm256_min_pd(best, x);
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, best);
+    double result = max ? *std::max_element(lanes, lanes + 4) : *std::min_element(lanes, lanes + 4);
+    for (; i < n; ++i) {
+        result = max ? std::max(result, xs[i]) : std::min(result, xs[i]);
+    }
+    return result;
+}
+
+
+AVX2_TARGET static double dotFloatsAvx2(const double *xs, const double *ys, size_t n) {
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(xs + i), _mm256_loadu_pd(ys + i)));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, acc);
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; ++i) {
+        total += xs[i] * ys[i];
+    }
+    return total;
+}
+
+
+AVX2_TARGET static bool addIntsAvx2(const long *xs, const long *ys, long *out, size_t n) {
+    __m256i overflow = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xs + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ys + i));
+        __m256i sum = _mm256_add_epi64(x, y);
+        overflow = _mm256_or_si256(overflow, _mm256_and_si256(_mm256_xor_si256(x, sum), _mm256_xor_si256(y, sum)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), sum);
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow))) {
+        return false;
+    }
+    return addIntsScalar(xs + i, ys + i, out + i, n - i);
+}
+
+
+enum class FloatOp { ADD, MUL, ABS, SQRT };
+
+
+AVX2_TARGET static inline __m256d applyAvx2(FloatOp op, __m256d x, __m256d y) {
+    switch (op) {
+        case FloatOp::ADD: return _mm256_add_pd(x, y);
+        case FloatOp::MUL: return _mm256_mul_pd(x, y);
+        case FloatOp::ABS: return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+        default: return _mm256_sqrt_pd(x);
+    }
+}
+
+
+// ys == nullptr broadcasts 'k' as the second operand instead
+AVX2_TARGET static void mapFloatsAvx2(FloatOp op, const double *xs, const double *ys, double k, double *out, size_t n) {
+    const __m256d broadcast = _mm256_set1_pd(k);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d y = ys ? _mm256_loadu_pd(ys + i) : broadcast;
+        _mm256_storeu_pd(out + i, applyAvx2(op, _mm256_loadu_pd(xs + i), y));
+    }
+    // the tail goes through the same vector op, padded with zeros
+    if (i < n) {
+        alignas(32) double x[4] = {0, 0, 0, 0}, y[4] = {k, k, k, k}, r[4];
+        std::copy(xs + i, xs + n, x);
+        if (ys) std::copy(ys + i, ys + n, y);
+        _mm256_store_pd(r, applyAvx2(op, _mm256_load_pd(x), _mm256_load_pd(y)));
+        std::copy(r, r + (n - i), out + i);
+    }
+}
+
+
+AVX2_TARGET static bool absIntsAvx2(const long *xs, long *out, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i minValue = _mm256_set1_epi64x(LONG_MIN);
+    __m256i overflow = zero;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xs + i));
+        overflow = _mm256_or_si256(overflow, _mm256_cmpeq_epi64(x, minValue));
+        __m256i negative = _mm256_cmpgt_epi64(zero, x);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                            _mm256_blendv_epi8(x, _mm256_sub_epi64(zero, x), negative));
+    }
+    if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow))) {
+        return false;
+    }
+    return absIntsScalar(xs + i, out + i, n - i);
+}
+
+AVX2_TARGET static bool isAsciiAvx2(const char *data, size_t n) {
+    __m256i high = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        high = _mm256_or_si256(high, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)));
+    }
+    return _mm256_movemask_epi8(high) == 0 && isAsciiScalar(data + i, n - i);
+}
+
+
+AVX2_TARGET static size_t countUtf8CharsAvx2(const char *data, size_t n) {
+    // continuation bytes 0x80-0xBF are exactly the signed bytes below -64
+    const __m256i threshold = _mm256_set1_epi8(-64);
+    size_t continuations = 0, i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(threshold, bytes)));
+        continuations += __builtin_popcount(mask);
+    }
+    return (i - continuations) + countUtf8CharsScalar(data + i, n - i);
+}
+
+
+// compares the needle's first and last bytes against 32 candidate positions at once
+// and runs a full comparison only where both match
+AVX2_TARGET static size_t findBytesAvx2(const char *haystack, size_t n, const char *needle, size_t m) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m + 31 <= n; i += 32) {
+        __m256i firstBytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(haystack + i));
+        __m256i lastBytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(haystack + i + m - 1));
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(first, firstBytes), _mm256_cmpeq_epi8(last, lastBytes))));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (std::memcmp(haystack + i + bit + 1, needle + 1, m - 1) == 0) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = findBytesScalar(haystack + i, n - i, needle, m);
+    return rest == std::string_view::npos ? rest : i + rest;
+}
+
+#endif
+
+// dispatch
+
+bool sumInts(const long *xs, size_t n, long &result) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return sumIntsAvx2(xs, n, result);
+#endif
+    return sumIntsScalar(xs, n, result);
+}
+
+
+double sumFloats(const double *xs, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return sumFloatsAvx2(xs, n);
+#endif
+    return sumFloatsScalar(xs, n);
+}
+
+
+long minInts(const long *xs, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return extremeIntsAvx2(xs, n, false);
+#endif
+    return *std::min_element(xs, xs + n);
+}
+
+
+long maxInts(const long *xs, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return extremeIntsAvx2(xs, n, true);
+#endif
+    return *std::max_element(xs, xs + n);
+}
+
+
+double minFloats(const double *xs, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return extremeFloatsAvx2(xs, n, false);
+#endif
+    return *std::min_element(xs, xs + n);
+}
+
+
+double maxFloats(const double *xs, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return extremeFloatsAvx2(xs, n, true);
+#endif
+    return *std::max_element(xs, xs + n);
+}
+
+
+// AVX2 has no 64-bit integer multiply, so the integer products stay scalar
+bool dotInts(const long *xs, const long *ys, size_t n, long &result) {
+    return dotIntsScalar(xs, ys, n, result);
+}
+
+
+double dotFloats(const double *xs, const double *ys, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return dotFloatsAvx2(xs, ys, n);
+#endif
+    return dotFloatsScalar(xs, ys, n);
+}
+
+
+bool addInts(const long *xs, const long *ys, long *out, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return addIntsAvx2(xs, ys, out, n);
+#endif
+    return addIntsScalar(xs, ys, out, n);
+}
+
+
+void addFloats(const double *xs, const double *ys, double *out, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) {
+        mapFloatsAvx2(FloatOp::ADD, xs, ys, 0.0, out, n);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = xs[i] + ys[i];
+    }
+}
+
+
+bool mulInts(const long *xs, const long *ys, long *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (__builtin_mul_overflow(xs[i], ys[i], &out[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void mulFloats(const double *xs, const double *ys, double *out, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) {
+        mapFloatsAvx2(FloatOp::MUL, xs, ys, 0.0, out, n);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = xs[i] * ys[i];
+    }
+}
+
+
+bool scaleInts(const long *xs, long k, long *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (__builtin_mul_overflow(xs[i], k, &out[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void scaleFloats(const double *xs, double k, double *out, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) {
+        mapFloatsAvx2(FloatOp::MUL, xs, nullptr, k, out, n);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = xs[i] * k;
+    }
+}
+
+
+bool absInts(const long *xs, long *out, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return absIntsAvx2(xs, out, n);
+#endif
+    return absIntsScalar(xs, out, n);
+}
+
+
+void absFloats(const double *xs, double *out, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) {
+        mapFloatsAvx2(FloatOp::ABS, xs, nullptr, 0.0, out, n);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = std::fabs(xs[i]);
+    }
+}
+
+
+void sqrtFloats(const double *xs, double *out, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) {
+        mapFloatsAvx2(FloatOp::SQRT, xs, nullptr, 0.0, out, n);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = std::sqrt(xs[i]);
+    }
+}
+
+
+bool isAscii(const char *data, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return isAsciiAvx2(data, n);
+#endif
+    return isAsciiScalar(data, n);
+}
+
+
+size_t countUtf8Chars(const char *data, size_t n) {
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return countUtf8CharsAvx2(data, n);
+#endif
+    return countUtf8CharsScalar(data, n);
+}
+
+
+size_t findBytes(const char *haystack, size_t n, const char *needle, size_t m) {
+    if (m == 0 || m > n) {
+        return m == 0 ? 0 : std::string_view::npos;
+    }
+#ifdef SIMD_AVX2
+    if (hasAvx2()) return findBytesAvx2(haystack, n, needle, m);
+#endif
+    return findBytesScalar(haystack, n, needle, m);
+}
@@ -0,0 +1,57 @@
+#ifndef CPP_INTERPRETER_SIMD_H
+#define CPP_INTERPRETER_SIMD_H
+
+#include <cstddef>
+
+// Kernels over unboxed list storage and string bytes. Each one runs an AVX2 version when the CPU reports support for it
+// and a scalar version otherwise. Integer kernels return false instead of wrapping around on overflow.
+
+// lets benchmarks compare the two: false runs the scalar versions even where AVX2 is supported
+void useSimd(bool enabled);
+
+bool sumInts(const long *xs, size_t n, long &result);
+
+double sumFloats(const double *xs, size_t n);
+
+long minInts(const long *xs, size_t n);
+
+long maxInts(const long *xs, size_t n);
+
+double minFloats(const double *xs, size_t n);
+
+double maxFloats(const double *xs, size_t n);
+
+bool dotInts(const long *xs, const long *ys, size_t n, long &result);
+
+double dotFloats(const double *xs, const double *ys, size_t n);
+
+bool addInts(const long *xs, const long *ys, long *out, size_t n);
+
+void addFloats(const double *xs, const double *ys, double *out, size_t n);
+
+bool mulInts(const long *xs, const long *ys, long *out, size_t n);
+
+void mulFloats(const double *xs, const double *ys, double *out, size_t n);
+
+bool scaleInts(const long *xs, long k, long *out, size_t n);
+
+void scaleFloats(const double *xs, double k, double *out, size_t n);
+
+bool absInts(const long *xs, long *out, size_t n);
+
+void absFloats(const double *xs, double *out, size_t n);
+
+void sqrtFloats(const double *xs, double *out, size_t n);
+
+// byte scans over strings
+
+bool isAscii(const char *data, size_t n);
+
+// the number of UTF-8 characters, i.e. bytes that are not continuation bytes
+size_t countUtf8Chars(const char *data, size_t n);
+
+// the byte offset of the first occurrence of the needle, or std::string_view::npos
+size_t findBytes(const char *haystack, size_t n, const char *needle, size_t m);
+
+
+#endif
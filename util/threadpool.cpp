@@ -0,0 +1,120 @@
+#include "threadpool.h"
+#include "counters.h"
+#include "profiler.h"
+#include <cstdlib>
+#include <string>
+
+
+static thread_local bool insidePool = false;
+
+
+ThreadPool::ThreadPool(size_t threads) {
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+
+ThreadPool &ThreadPool::instance() {
+    static ThreadPool pool([] {
+        size_t threads = std::thread::hardware_concurrency();
+        if (const char *requested = std::getenv("INTERP_THREADS")) {
+            try {
+                threads = std::stoul(requested);
+            } catch (const std::exception &) {}
+        }
+        return threads > 0 ? threads : 1;
+    }());
+    return pool;
+}
+
+
+bool ThreadPool::inTask() {
+    return insidePool;
+}
+
+
+void ThreadPool::work() {
+    insidePool = true;
+    blockSamples();
+    registerCounters();
+    size_t seen = 0;
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                unregisterCounters();
+                return;
+            }
+            seen = generation;
+            // null if the job already finished without this worker
+            job = current;
+        }
+        if (job) {
+            drain(*job);
+        }
+    }
+}
+
+
+// a worker that wakes up late finds the job's tasks all taken and never touches its task again
+void ThreadPool::drain(Job &job) {
+    for (size_t i; (i = job.next.fetch_add(1)) < job.count;) {
+        try {
+            job.task(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(job.errorMutex);
+            if (!job.error) {
+                job.error = std::current_exception();
+            }
+        }
+        if (job.unfinished.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+    }
+}
+
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)> &task) {
+    if (insidePool || workers.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+    std::lock_guard<std::mutex> running(runMutex);
+    auto job = std::make_shared<Job>(task, count);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = job;
+        ++generation;
+    }
+    wake.notify_all();
+
+    insidePool = true;
+    drain(*job);
+    insidePool = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return job->unfinished.load() == 0; });
+        current.reset();
+    }
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
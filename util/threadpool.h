@@ -0,0 +1,60 @@
+#ifndef CPP_INTERPRETER_THREADPOOL_H
+#define CPP_INTERPRETER_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// worker threads shared by the parallel builtins, started on first use. There is one thread per core, counting the
+// calling thread, unless the INTERP_THREADS environment variable asks for a different number
+class ThreadPool {
+private:
+    struct Job {
+        const std::function<void(size_t)> &task;
+        size_t count;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> unfinished;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        Job(const std::function<void(size_t)> &task, size_t count) : task(task), count(count), unfinished(count) {}
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::shared_ptr<Job> current;
+    size_t generation = 0;
+    bool stopping = false;
+    // one job at a time
+    std::mutex runMutex;
+
+    explicit ThreadPool(size_t threads);
+
+    void work();
+
+    void drain(Job &job);
+
+public:
+    ~ThreadPool();
+
+    static ThreadPool &instance();
+
+    size_t size() const { return workers.size() + 1; }
+
+    // true on a thread that is running one of the pool's tasks
+    static bool inTask();
+
+    // runs task(0) to task(count - 1) on the workers and the calling thread, and returns once all of them finished.
+    // the first exception a task throws is rethrown here. Called from inside a task, it runs everything in place
+    void run(size_t count, const std::function<void(size_t)> &task);
+};
+
+
+#endif
@@ -0,0 +1,75 @@
+#include "trace.h"
+#include "profiler.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+
+thread_local constinit bool traceThread = false;
+
+struct TraceEvent {
+    // since the trace started
+    std::chrono::nanoseconds start, duration;
+    uint32_t label;
+    uint32_t line;
+    TraceSpan::Kind kind;
+};
+
+static std::vector<TraceEvent> events;
+static std::string output;
+static std::chrono::steady_clock::time_point started;
+static std::chrono::nanoseconds threshold{0};
+static size_t skipped = 0;
+
+
+void TraceSpan::begin() {
+    active = true;
+    line = currentLine();
+    start = std::chrono::steady_clock::now();
+}
+
+
+void TraceSpan::end() {
+    auto duration = std::chrono::steady_clock::now() - start;
+    if (duration < threshold) {
+        ++skipped;
+        return;
+    }
+    events.push_back({start - started, duration, label, line, kind});
+}
+
+
+void startTrace(const std::string &outputPath, std::chrono::microseconds minimum) {
+    output = outputPath;
+    threshold = minimum;
+    traceThread = true;
+    started = std::chrono::steady_clock::now();
+}
+
+
+void stopTrace() {
+    if (!traceThread) {
+        return;
+    }
+    traceThread = false;
+    static const char *categories[] = {"function", "builtin", "statement"};
+
+    std::ofstream file(output);
+    file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent &event = events[i];
+        const char *category = categories[static_cast<int>(event.kind)];
+        std::string name = event.kind == TraceSpan::Kind::STATEMENT ? "line " + std::to_string(event.line)
+                                                                    : labelName(event.label);
+        file << (i ? ",\n" : "\n") << "{\"name\": \"" << name << "\", \"cat\": \"" << category
+             << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": " << event.start.count() / 1000.0
+             << ", \"dur\": " << event.duration.count() / 1000.0 << ", \"args\": {\"line\": " << event.line << "}}";
+    }
+    file << "\n]}\n";
+    std::cerr << "Trace: " << events.size() << " events written to " << output;
+    if (skipped) {
+        std::cerr << " (" << skipped << " shorter than " << threshold.count() / 1000 << "us left out)";
+    }
+    std::cerr << std::endl;
+}
@@ -0,0 +1,56 @@
+#ifndef CPP_INTERPRETER_TRACE_H
+#define CPP_INTERPRETER_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+// true on the thread whose calls are traced. The parallel builtins' workers aren't, so their time shows up inside
+// the span of the builtin that started them
+extern thread_local constinit bool traceThread;
+
+// one event of the timeline, from its construction to its destruction
+class TraceSpan {
+public:
+    enum class Kind : uint8_t { FUNCTION, BUILTIN, STATEMENT };
+
+private:
+    std::chrono::steady_clock::time_point start;
+    uint32_t label;
+    // the line running when the span began, which for a call is the line that made it
+    uint32_t line = 0;
+    Kind kind;
+    bool active = false;
+
+    void begin();
+
+    void end();
+
+public:
+    // label is a profileLabel()
+    TraceSpan(Kind kind, uint32_t label) : label(label), kind(kind) {
+        if (traceThread) {
+            begin();
+        }
+    }
+
+    ~TraceSpan() {
+        if (active) {
+            end();
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+
+    TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+// starts recording the calling thread's spans that last at least the threshold
+void startTrace(const std::string &outputPath, std::chrono::microseconds threshold);
+
+// writes the spans recorded so far in Chrome's trace event format, which chrome://tracing and Perfetto open
+void stopTrace();
+
+
+#endif
@@ -1,4 +1,5 @@
 #include "utf8string.h"
+#include "simd.h"
 
 
 size_t getStrLen(const std::string &s) {
@@ -51,3 +52,113 @@ std::string getStrChar(const std::string &s, size_t index) {
     }
     return s.substr(i, char_len);
 }
+
+
+size_t utf8CharWidth(unsigned char c) {
+    if ((c & 0x80) == 0x00) {
+        return 1;
+    } else if ((c & 0xE0) == 0xC0) {
+        return 2;
+    } else if ((c & 0xF0) == 0xE0) {
+        return 3;
+    } else if ((c & 0xF8) == 0xF0) {
+        return 4;
+    }
+    throw std::runtime_error("Invalid UTF-8 encoding");
+}
+
+
+Utf8Index::Utf8Index(const Utf8Index &other) {
+    if (other.countState.load(std::memory_order_acquire) == READY) {
+        ascii = other.ascii;
+        length = other.length;
+        countState.store(READY, std::memory_order_relaxed);
+    }
+    if (other.offsetState.load(std::memory_order_acquire) == READY) {
+        checkpoints = other.checkpoints;
+        offsetState.store(READY, std::memory_order_relaxed);
+    }
+}
+
+
+void Utf8Index::reset() {
+    countState.store(EMPTY, std::memory_order_relaxed);
+    offsetState.store(EMPTY, std::memory_order_relaxed);
+    checkpoints.clear();
+}
+
+
+// the first caller publishes its result; callers racing with it use their own copy
+void Utf8Index::count(const std::string &s, bool &isAsciiStr, size_t &chars) const {
+    if (countState.load(std::memory_order_acquire) == READY) {
+        isAsciiStr = ascii;
+        chars = length;
+        return;
+    }
+    isAsciiStr = isAscii(s.data(), s.size());
+    chars = isAsciiStr ? s.size() : countUtf8Chars(s.data(), s.size());
+    int expected = EMPTY;
+    if (countState.compare_exchange_strong(expected, BUILDING, std::memory_order_acq_rel)) {
+        ascii = isAsciiStr;
+        length = chars;
+        countState.store(READY, std::memory_order_release);
+    }
+}
+
+
+size_t Utf8Index::scanOffset(const std::string &s, size_t from, size_t fromIndex, size_t index) const {
+    size_t offset = from;
+    for (size_t i = fromIndex; i < index && offset < s.size(); ++i) {
+        offset += utf8CharWidth(s[offset]);
+    }
+    return offset;
+}
+
+
+size_t Utf8Index::charCount(const std::string &s) const {
+    bool isAsciiStr;
+    size_t chars;
+    count(s, isAsciiStr, chars);
+    return chars;
+}
+
+
+size_t Utf8Index::byteOffset(const std::string &s, size_t index) const {
+    bool isAsciiStr;
+    size_t chars;
+    count(s, isAsciiStr, chars);
+    if (isAsciiStr) {
+        return index;
+    }
+
+    int state = offsetState.load(std::memory_order_acquire);
+    if (state == EMPTY && offsetState.compare_exchange_strong(state, BUILDING, std::memory_order_acq_rel)) {
+        try {
+            checkpoints.reserve(chars / STRIDE + 1);
+            for (size_t offset = 0, i = 0; offset < s.size(); ++i) {
+                if (i % STRIDE == 0) {
+                    checkpoints.push_back(offset);
+                }
+                offset += utf8CharWidth(s[offset]);
+            }
+        } catch (...) {
+            checkpoints.clear();
+            offsetState.store(EMPTY, std::memory_order_release);
+            throw;
+        }
+        offsetState.store(READY, std::memory_order_release);
+        state = READY;
+    }
+    if (state == READY && index / STRIDE < checkpoints.size()) {
+        size_t checkpoint = index / STRIDE;
+        return scanOffset(s, checkpoints[checkpoint], checkpoint * STRIDE, index);
+    }
+    // still being built by another thread
+    return scanOffset(s, 0, 0, index);
+}
+
+
+std::string Utf8Index::charAt(const std::string &s, size_t index) const {
+    size_t offset = byteOffset(s, index);
+    return s.substr(offset, utf8CharWidth(s[offset]));
+}
@@ -2,11 +2,49 @@
 #define CPP_INTERPRETER_UTF8STRING_H
 
 #include <iostream>
+#include <atomic>
+#include <vector>
 
 
 size_t getStrLen(const std::string &s);
 
 std::string getStrChar(const std::string &s, size_t index);
 
+// the byte length of the character starting with this lead byte
+size_t utf8CharWidth(unsigned char lead);
 
-#endif
\ No newline at end of file
+
+// Character-level facts about one string, computed on first use and kept until the string changes:
+// whether it is pure ASCII, its length in characters, and the byte offset of every STRIDE-th character.
+// Lookups are safe from several threads; reset() may only be called by the string's sole owner.
+class Utf8Index {
+private:
+    static constexpr size_t STRIDE = 64;
+    enum State { EMPTY, BUILDING, READY };
+
+    mutable std::atomic<int> countState{EMPTY};
+    mutable std::atomic<int> offsetState{EMPTY};
+    mutable bool ascii = false;
+    mutable size_t length = 0;
+    mutable std::vector<size_t> checkpoints;
+
+    void count(const std::string &s, bool &isAsciiStr, size_t &chars) const;
+
+    size_t scanOffset(const std::string &s, size_t from, size_t fromIndex, size_t index) const;
+
+public:
+    Utf8Index() = default;
+
+    Utf8Index(const Utf8Index &other);
+
+    void reset();
+
+    size_t charCount(const std::string &s) const;
+
+    size_t byteOffset(const std::string &s, size_t index) const;
+
+    std::string charAt(const std::string &s, size_t index) const;
+};
+
+
+#endif